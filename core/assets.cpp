@@ -0,0 +1,409 @@
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include "assets.h"
+#include "pixelformat.h"
+
+namespace
+{
+  //! Rows copied between two checks of the clock
+  const int UploadRowsPerCheck = 16;
+
+  //! Largest width or height of an image, larger files are rejected before allocating
+  const int MaxImageSize = 16384;
+
+  //! FNV-1a hash of the file content
+  unsigned long long hashContent(const std::vector<unsigned char>& bytes)
+  {
+    unsigned long long hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < bytes.size(); ++i)
+    {
+      hash ^= bytes[i];
+      hash *= 1099511628211ULL;
+    }
+    return hash;
+  }
+
+  unsigned int readU16(const unsigned char* p) { return p[0] | (p[1] << 8); }
+  unsigned int readU32(const unsigned char* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24); }
+
+  //! Decode an uncompressed 24 or 32 bit BMP
+  bool decodeBmp(const std::vector<unsigned char>& bytes, AssetData& out)
+  {
+    if ((bytes.size() < 54) || (bytes[0] != 'B') || (bytes[1] != 'M'))
+      return false;
+
+    const unsigned char* header = bytes.data();
+    unsigned int dataOffset = readU32(header + 10);
+    long long headerWidth = (int)readU32(header + 18);
+    long long headerHeight = (int)readU32(header + 22);
+    unsigned int bitsPerPixel = readU16(header + 28);
+    unsigned int compression = readU32(header + 30);
+
+    // 0 = BI_RGB, 3 = BI_BITFIELDS with the default masks
+    if (((bitsPerPixel != 24) && (bitsPerPixel != 32)) || ((compression != 0) && (compression != 3)))
+      return false;
+
+    // Positive heights are stored bottom up, 64 bit so that negating INT_MIN is fine
+    bool bottomUp = headerHeight > 0;
+    headerHeight = bottomUp ? headerHeight : -headerHeight;
+    if ((headerWidth <= 0) || (headerHeight <= 0) || (headerWidth > MaxImageSize) || (headerHeight > MaxImageSize))
+      return false;
+
+    int width = (int)headerWidth;
+    int height = (int)headerHeight;
+
+    // 64 bit sizes, the product does not fit a 32 bit size_t for large headers
+    int bytesPerPixel = bitsPerPixel / 8;
+    size_t rowSize = ((size_t)width * bytesPerPixel + 3) & ~(size_t)3;
+    if (dataOffset + (unsigned long long)rowSize * height > bytes.size())
+      return false;
+
+    out.width = width;
+    out.height = height;
+    out.pixels.resize((size_t)width * height);
+    for (int y = 0; y < height; ++y)
+    {
+      const unsigned char* src = bytes.data() + dataOffset + rowSize * (bottomUp ? (height - 1 - y) : y);
+      unsigned int* dst = out.pixels.data() + (size_t)y * width;
+      for (int x = 0; x < width; ++x)
+      {
+        const unsigned char* p = src + x * bytesPerPixel;
+        unsigned int a = (bytesPerPixel == 4) ? p[3] : 0xFF;
+        dst[x] = PixelFormatBackBuffer::pack(p[2], p[1], p[0], a);
+      }
+    }
+    return true;
+  }
+
+  //! Decode an uncompressed 24 or 32 bit true color TGA
+  bool decodeTga(const std::vector<unsigned char>& bytes, AssetData& out)
+  {
+    if (bytes.size() < 18)
+      return false;
+
+    const unsigned char* header = bytes.data();
+    unsigned int idLength = header[0];
+    unsigned int colorMapType = header[1];
+    unsigned int imageType = header[2];
+    int width = (int)readU16(header + 12);
+    int height = (int)readU16(header + 14);
+    unsigned int bitsPerPixel = header[16];
+    unsigned int descriptor = header[17];
+
+    if ((colorMapType != 0) || (imageType != 2) || ((bitsPerPixel != 24) && (bitsPerPixel != 32)))
+      return false;
+    if ((width <= 0) || (height <= 0) || (width > MaxImageSize) || (height > MaxImageSize))
+      return false;
+
+    int bytesPerPixel = bitsPerPixel / 8;
+    size_t dataOffset = 18 + idLength;
+    if (dataOffset + (unsigned long long)width * height * bytesPerPixel > bytes.size())
+      return false;
+
+    // Bit 5 of the descriptor is set for top down images
+    bool bottomUp = (descriptor & 0x20) == 0;
+
+    out.width = width;
+    out.height = height;
+    out.pixels.resize((size_t)width * height);
+    for (int y = 0; y < height; ++y)
+    {
+      const unsigned char* src = bytes.data() + dataOffset + (size_t)width * bytesPerPixel * (bottomUp ? (height - 1 - y) : y);
+      unsigned int* dst = out.pixels.data() + (size_t)y * width;
+      for (int x = 0; x < width; ++x)
+      {
+        const unsigned char* p = src + x * bytesPerPixel;
+        unsigned int a = (bytesPerPixel == 4) ? p[3] : 0xFF;
+        dst[x] = PixelFormatBackBuffer::pack(p[2], p[1], p[0], a);
+      }
+    }
+    return true;
+  }
+}
+
+//! Constructor
+AssetLoader::AssetLoader(int cThreadCount)
+  : mWorkers(cThreadCount)
+{
+}
+
+//! Destructor
+AssetLoader::~AssetLoader()
+{
+  // Wait for the workers, they may still reference the assets
+  for (size_t i = 0; i < mAssets.size(); ++i)
+  {
+    if (mAssets[i]->decoding.valid())
+      mAssets[i]->decoding.wait();
+    delete mAssets[i];
+  }
+}
+
+//! Queue an asset for loading
+AssetHandle AssetLoader::load(const char* cpPath, AssetType type)
+{
+  std::string path(cpPath);
+
+  // Concurrent requests for the same file share one handle
+  std::pair<std::string, AssetType> key(path, type);
+  std::map<std::pair<std::string, AssetType>, AssetHandle>::iterator found = mHandlesByPath.find(key);
+  if (found != mHandlesByPath.end())
+    return found->second;
+
+  Asset* asset = new Asset();
+  asset->path = path;
+  asset->type = type;
+  asset->state = AssetState_Loading;
+  asset->uploadedRows = 0;
+  asset->sharedWith = InvalidAssetHandle;
+  asset->decoding = mWorkers.submit([this, path, type]() { return decodeAsset(path, type); });
+
+  AssetHandle handle = (AssetHandle)mAssets.size();
+  mAssets.push_back(asset);
+  mHandlesByPath[key] = handle;
+  return handle;
+}
+
+//! Collect finished decodes and upload pixels within the budget
+void AssetLoader::update(float budgetMs)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::chrono::duration<float, std::milli> budget(budgetMs);
+
+  for (size_t i = 0; i < mAssets.size(); ++i)
+  {
+    Asset* asset = mAssets[i];
+
+    if (asset->state == AssetState_Loading)
+    {
+      if (asset->decoding.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        continue;
+
+      // Reading the file can run out of memory before the decode starts
+      try
+      {
+        asset->data = asset->decoding.get();
+      }
+      catch (const std::exception& e)
+      {
+        printf("Loading asset '%s' failed: %s\n", asset->path.c_str(), e.what());
+        failAsset((AssetHandle)i);
+        continue;
+      }
+
+      if (asset->data == nullptr)
+      {
+        printf("Loading asset '%s' failed\n", asset->path.c_str());
+        failAsset((AssetHandle)i);
+        continue;
+      }
+
+      // Content that another asset already holds is not uploaded again
+      std::map<unsigned long long, AssetHandle>::iterator owner = mHandlesByContent.find(asset->data->contentKey);
+      if (owner != mHandlesByContent.end())
+      {
+        asset->sharedWith = owner->second;
+        asset->data.reset();
+        asset->state = AssetState_Ready;
+        continue;
+      }
+      mHandlesByContent[asset->data->contentKey] = (AssetHandle)i;
+
+      if (asset->type == AssetType_Image)
+      {
+        asset->surface.resize(asset->data->width, asset->data->height);
+        asset->state = AssetState_Uploading;
+      }
+      else
+        finishUpload(asset);
+    }
+
+    // Copy rows until the image is done or the budget is used up
+    while (asset->state == AssetState_Uploading)
+    {
+      if (std::chrono::steady_clock::now() - start >= budget)
+        return;
+
+      ScreenPixelData* pixelData = asset->surface.getPixelData();
+      const AssetData& data = *asset->data;
+      int rowEnd = asset->uploadedRows + UploadRowsPerCheck;
+      rowEnd = rowEnd > data.height ? data.height : rowEnd;
+
+      for (int y = asset->uploadedRows; y < rowEnd; ++y)
+        memcpy(pixelData->data + y * (pixelData->pitch / 4), data.pixels.data() + (size_t)y * data.width, data.width * 4);
+
+      asset->uploadedRows = rowEnd;
+      if (asset->uploadedRows == data.height)
+        finishUpload(asset);
+    }
+  }
+}
+
+//! Return the state of an asset
+AssetState AssetLoader::getState(AssetHandle handle) const
+{
+  const Asset* asset = resolve(handle);
+  return (asset != nullptr) ? asset->state : AssetState_Failed;
+}
+
+//! Return the path an asset was loaded from
+const char* AssetLoader::getPath(AssetHandle handle) const
+{
+  if ((handle < 0) || (handle >= (AssetHandle)mAssets.size()))
+    return nullptr;
+  return mAssets[handle]->path.c_str();
+}
+
+//! Return the surface of a ready image
+Surface* AssetLoader::getImage(AssetHandle handle)
+{
+  Asset* asset = resolve(handle);
+  if ((asset == nullptr) || (asset->state != AssetState_Ready) || (asset->type != AssetType_Image))
+    return nullptr;
+
+  return &asset->surface;
+}
+
+//! Return the bytes of a ready font
+const std::vector<unsigned char>* AssetLoader::getFontData(AssetHandle handle) const
+{
+  const Asset* asset = resolve(handle);
+  if ((asset == nullptr) || (asset->state != AssetState_Ready) || (asset->type != AssetType_Font))
+    return nullptr;
+
+  return (asset->data != nullptr) ? &asset->data->bytes : nullptr;
+}
+
+//! Count the assets that are still in flight
+int AssetLoader::getPendingCount() const
+{
+  int count = 0;
+  for (size_t i = 0; i < mAssets.size(); ++i)
+  {
+    if ((mAssets[i]->state == AssetState_Loading) || (mAssets[i]->state == AssetState_Uploading))
+      count++;
+  }
+  return count;
+}
+
+//! Read and decode a file, runs on a worker
+std::shared_ptr<const AssetData> AssetLoader::decodeAsset(const std::string& path, AssetType type)
+{
+  std::ifstream file(path.c_str(), std::ios::binary);
+  if (!file)
+    return nullptr;
+
+  std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+  // The type is part of the key, the same bytes decode differently per type
+  unsigned long long key = hashContent(bytes) ^ (unsigned long long)type;
+
+  // The first request for some content decodes it, later ones wait for that
+  // result or, once an asset holds the content, skip decoding altogether
+  std::shared_future<std::shared_ptr<const AssetData>> decoding;
+  std::promise<std::shared_ptr<const AssetData>> promise;
+  bool resident = false;
+  {
+    std::lock_guard<std::mutex> lock(mContentMutex);
+    if (mContentResident.count(key) != 0)
+      resident = true;
+    else
+    {
+      auto found = mContentDecoding.find(key);
+      if (found != mContentDecoding.end())
+        decoding = found->second;
+      else
+        mContentDecoding[key] = promise.get_future().share();
+    }
+  }
+
+  if (decoding.valid())
+    return decoding.get();
+
+  // A failed decode, out of memory included, still settles the promise so
+  // that requests waiting for this content fail as well
+  std::shared_ptr<AssetData> data;
+  try
+  {
+    data = std::make_shared<AssetData>();
+    data->contentKey = key;
+    data->resident = resident;
+    data->width = 0;
+    data->height = 0;
+
+    if (resident)
+      return data;
+
+    if (type == AssetType_Image)
+    {
+      if (!decodeBmp(bytes, *data) && !decodeTga(bytes, *data))
+        data.reset();
+    }
+    else
+      data->bytes.swap(bytes);
+  }
+  catch (const std::exception& e)
+  {
+    printf("Decoding asset '%s' failed: %s\n", path.c_str(), e.what());
+    data.reset();
+  }
+
+  // Resident content never registered a promise, there is nobody to notify
+  if (resident)
+    return nullptr;
+
+  std::shared_ptr<const AssetData> result = data;
+  promise.set_value(result);
+
+  // Failed content may be retried by a later request
+  if (result == nullptr)
+  {
+    std::lock_guard<std::mutex> lock(mContentMutex);
+    mContentDecoding.erase(key);
+  }
+
+  return result;
+}
+
+//! Mark an asset as ready and hand its content over to the resident set
+void AssetLoader::finishUpload(Asset* asset)
+{
+  unsigned long long key = asset->data->contentKey;
+
+  // Images live in their surface now, fonts keep their bytes
+  if (asset->type == AssetType_Image)
+    asset->data.reset();
+
+  {
+    std::lock_guard<std::mutex> lock(mContentMutex);
+    mContentDecoding.erase(key);
+    mContentResident.insert(key);
+  }
+
+  asset->state = AssetState_Ready;
+}
+
+//! Mark an asset as failed, a later load() of its path tries again
+void AssetLoader::failAsset(AssetHandle handle)
+{
+  Asset* asset = mAssets[handle];
+  asset->state = AssetState_Failed;
+
+  std::pair<std::string, AssetType> key(asset->path, asset->type);
+  std::map<std::pair<std::string, AssetType>, AssetHandle>::iterator found = mHandlesByPath.find(key);
+  if ((found != mHandlesByPath.end()) && (found->second == handle))
+    mHandlesByPath.erase(found);
+}
+
+//! Follow shared content to the asset that holds it
+AssetLoader::Asset* AssetLoader::resolve(AssetHandle handle) const
+{
+  if ((handle < 0) || (handle >= (AssetHandle)mAssets.size()))
+    return nullptr;
+
+  Asset* asset = mAssets[handle];
+  if (asset->sharedWith != InvalidAssetHandle)
+    return mAssets[asset->sharedWith];
+  return asset;
+}
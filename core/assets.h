@@ -0,0 +1,125 @@
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "device.h"
+#include "surface.h"
+#include "workerpool.h"
+
+//! Handle to an asset, stays valid for the lifetime of the loader
+typedef int AssetHandle;
+const AssetHandle InvalidAssetHandle = -1;
+
+//! Kinds of assets
+enum AssetType
+{
+  //! Decoded to pixels (BMP and TGA, uncompressed)
+  AssetType_Image,
+  //! Kept as the raw file bytes, e.g. a font file for a text renderer
+  AssetType_Font,
+};
+
+//! Where an asset is in the pipeline
+enum AssetState
+{
+  AssetState_Loading,
+  AssetState_Uploading,
+  AssetState_Ready,
+  AssetState_Failed,
+};
+
+//! Decoded content, shared between assets with identical file contents
+struct AssetData
+{
+  //! Hash of the file content and asset type
+  unsigned long long contentKey;
+
+  //! Set when the content is already held by another asset and was not decoded
+  bool resident;
+
+  //! Image pixels in the back buffer format
+  int width;
+  int height;
+  std::vector<unsigned int> pixels;
+
+  //! File bytes for assets that are not decoded
+  std::vector<unsigned char> bytes;
+};
+
+//! Loads assets on a worker pool while the application keeps rendering
+//  load() returns a handle right away. Reading and decoding happen on the
+//  workers. Files with the same content hash are decoded once, and later
+//  assets with that content share the pixels of the first one. The decoded
+//  pixels are copied into the asset surface by update(), a few rows at a time
+//  within a time budget, so a big image never stalls a frame.
+class AssetLoader
+{
+public:
+  AssetLoader(int cThreadCount = 0);
+  ~AssetLoader();
+
+  //! Request an asset, loading the same path and type again returns the same handle
+  //  Once an asset failed, loading its path again starts a new attempt with a new handle.
+  AssetHandle load(const char* cpPath, AssetType type);
+
+  //! Upload decoded assets for at most 'budgetMs' milliseconds
+  // Note: Call once per frame from the thread that renders
+  void update(float budgetMs);
+
+  //! Access to the assets
+  AssetState getState(AssetHandle handle) const;
+  const char* getPath(AssetHandle handle) const;
+
+  //! Pixels of a ready image, or null if it is not ready (yet)
+  Surface* getImage(AssetHandle handle);
+
+  //! Bytes of a ready font, or null if it is not ready (yet)
+  const std::vector<unsigned char>* getFontData(AssetHandle handle) const;
+
+  //! Number of assets that are not ready or failed yet
+  int getPendingCount() const;
+
+private:
+  struct Asset
+  {
+    std::string path;
+    AssetType type;
+    AssetState state;
+
+    //! Result of the worker, valid once the future is ready
+    std::future<std::shared_ptr<const AssetData>> decoding;
+    std::shared_ptr<const AssetData> data;
+
+    //! Upload progress
+    Surface surface;
+    int uploadedRows;
+
+    //! Asset that holds the same content, or InvalidAssetHandle
+    AssetHandle sharedWith;
+  };
+
+  std::shared_ptr<const AssetData> decodeAsset(const std::string& path, AssetType type);
+  void finishUpload(Asset* asset);
+  void failAsset(AssetHandle handle);
+  Asset* resolve(AssetHandle handle) const;
+
+private:
+  //! Assets by handle, only touched by the thread that calls load() and update()
+  std::vector<Asset*> mAssets;
+  std::map<std::pair<std::string, AssetType>, AssetHandle> mHandlesByPath;
+  std::map<unsigned long long, AssetHandle> mHandlesByContent;
+
+  //! Content that is being decoded and content that is already held by an asset,
+  //! shared with the workers
+  std::mutex mContentMutex;
+  std::map<unsigned long long, std::shared_future<std::shared_ptr<const AssetData>>> mContentDecoding;
+  std::set<unsigned long long> mContentResident;
+
+  //! Declared last so the workers stop before the members they use are destroyed
+  WorkerPool mWorkers;
+};
@@ -0,0 +1,222 @@
+#include <cstring>
+#include <emmintrin.h>
+#include "compositor.h"
+
+namespace
+{
+  //! Blend 'count' pixels of 'src' over 'dst'
+  //  Two pixels per register with 16 bit channels: dst = (src * a + dst * (256 - a)) >> 8,
+  //  with 'a' from the layer opacity and, for alpha layers, the pixel alpha.
+  void blendRow(unsigned int* dst, const unsigned int* src, int count, unsigned int opacity, bool perPixelAlpha)
+  {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i full = _mm_set1_epi16(256);
+    const __m128i layerAlpha = _mm_set1_epi32((int)opacity);
+
+    int x = 0;
+    for (; x + 4 <= count; x += 4)
+    {
+      __m128i srcPixels = _mm_loadu_si128((const __m128i*)(src + x));
+      __m128i dstPixels = _mm_loadu_si128((const __m128i*)(dst + x));
+
+      // One alpha per pixel in [0, 256]
+      __m128i alpha = layerAlpha;
+      if (perPixelAlpha)
+      {
+        alpha = _mm_srli_epi16(_mm_mullo_epi16(_mm_srli_epi32(srcPixels, 24), layerAlpha), 8);
+        alpha = _mm_add_epi32(alpha, _mm_srli_epi32(alpha, 7));
+      }
+
+      // Spread each alpha over the 4 channels of its pixel
+      __m128i alpha16 = _mm_packs_epi32(alpha, alpha);
+      alpha16 = _mm_unpacklo_epi16(alpha16, alpha16);
+      __m128i alphaLo = _mm_unpacklo_epi32(alpha16, alpha16);
+      __m128i alphaHi = _mm_unpackhi_epi32(alpha16, alpha16);
+
+      __m128i srcLo = _mm_unpacklo_epi8(srcPixels, zero);
+      __m128i srcHi = _mm_unpackhi_epi8(srcPixels, zero);
+      __m128i dstLo = _mm_unpacklo_epi8(dstPixels, zero);
+      __m128i dstHi = _mm_unpackhi_epi8(dstPixels, zero);
+
+      __m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(srcLo, alphaLo), _mm_mullo_epi16(dstLo, _mm_sub_epi16(full, alphaLo))), 8);
+      __m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(srcHi, alphaHi), _mm_mullo_epi16(dstHi, _mm_sub_epi16(full, alphaHi))), 8);
+
+      _mm_storeu_si128((__m128i*)(dst + x), _mm_packus_epi16(lo, hi));
+    }
+
+    for (; x < count; ++x)
+    {
+      unsigned int alpha = opacity;
+      if (perPixelAlpha)
+      {
+        alpha = ((src[x] >> 24) * opacity) >> 8;
+        alpha += alpha >> 7;
+      }
+
+      unsigned int invAlpha = 256 - alpha;
+      unsigned int rb = (((src[x] & 0x00FF00FF) * alpha + (dst[x] & 0x00FF00FF) * invAlpha) >> 8) & 0x00FF00FF;
+      unsigned int ag = ((((src[x] >> 8) & 0x00FF00FF) * alpha + ((dst[x] >> 8) & 0x00FF00FF) * invAlpha) >> 8) & 0x00FF00FF;
+      dst[x] = rb | (ag << 8);
+    }
+  }
+}
+
+//! Constructor
+Layer::Layer(const char* cpName, int cWidth, int cHeight, LayerRenderCallback pCallback, void* pUserData)
+  : mName(cpName)
+  , mSurface(cWidth, cHeight)
+  , mX(0)
+  , mY(0)
+  , mOpacity(1.0f)
+  , mBlend(LayerBlend_Opaque)
+  , mVisible(true)
+  , mDirty(true)
+  , mRenderCallback(pCallback)
+  , mUserData(pUserData)
+{
+}
+
+//! Resize the layer surface
+void Layer::resize(int width, int height)
+{
+  if ((width != mSurface.getWidth()) || (height != mSurface.getHeight()))
+  {
+    mSurface.resize(width, height);
+    mDirty = true;
+  }
+}
+
+//! Re-render the content when needed
+void Layer::update()
+{
+  if (!mDirty)
+    return;
+
+  ScreenPixelData* pixelData = mSurface.getPixelData();
+  if (pixelData == nullptr)
+    return;
+
+  // Alpha layers start out fully transparent
+  if (mBlend == LayerBlend_Alpha)
+    mSurface.clear(0);
+
+  if (mRenderCallback != nullptr)
+    mRenderCallback(*this, pixelData, mUserData);
+
+  mDirty = false;
+}
+
+//! Constructor
+Compositor::Compositor()
+  : mBackground(0)
+{
+}
+
+//! Destructor
+Compositor::~Compositor()
+{
+  for (size_t i = 0; i < mLayers.size(); ++i)
+    delete mLayers[i];
+}
+
+//! Create a layer, names have to be unique
+Layer* Compositor::addLayer(const char* cpName, int width, int height, LayerRenderCallback pCallback, void* pUserData)
+{
+  if (getLayer(cpName) != nullptr)
+  {
+    printf("Compositor layer '%s' already exists\n", cpName);
+    return nullptr;
+  }
+
+  Layer* layer = new Layer(cpName, width, height, pCallback, pUserData);
+  mLayers.push_back(layer);
+  return layer;
+}
+
+//! Destroy a layer
+void Compositor::removeLayer(const char* cpName)
+{
+  for (size_t i = 0; i < mLayers.size(); ++i)
+  {
+    if (strcmp(mLayers[i]->getName(), cpName) == 0)
+    {
+      delete mLayers[i];
+      mLayers.erase(mLayers.begin() + i);
+      return;
+    }
+  }
+}
+
+//! Find a layer by name
+Layer* Compositor::getLayer(const char* cpName)
+{
+  for (size_t i = 0; i < mLayers.size(); ++i)
+  {
+    if (strcmp(mLayers[i]->getName(), cpName) == 0)
+      return mLayers[i];
+  }
+  return nullptr;
+}
+
+//! Update the dirty layers and blend everything into the destination
+void Compositor::compose(ScreenPixelData* dst)
+{
+  if ((dst == nullptr) || (dst->data == nullptr))
+    return;
+
+  // Only dirty layers are rendered
+  for (size_t i = 0; i < mLayers.size(); ++i)
+  {
+    if (mLayers[i]->isVisible())
+      mLayers[i]->update();
+  }
+
+  const int stride = dst->pitch / 4;
+  for (int y = 0; y < dst->height; ++y)
+  {
+    unsigned int* dstRow = dst->data + y * stride;
+    bool covered = false;
+
+    for (size_t i = 0; i < mLayers.size(); ++i)
+    {
+      Layer* layer = mLayers[i];
+      const ScreenPixelData* src = layer->getSurface().getPixelData();
+      if (!layer->isVisible() || (src == nullptr) || (layer->getOpacity() <= 0.0f))
+        continue;
+
+      int srcY = y - layer->getY();
+      if ((srcY < 0) || (srcY >= src->height))
+        continue;
+
+      int x0 = layer->getX() < 0 ? 0 : layer->getX();
+      int x1 = (layer->getX() + src->width) > dst->width ? dst->width : (layer->getX() + src->width);
+      if (x0 >= x1)
+        continue;
+
+      // Fill the row with the background before the first layer that is not a plain copy
+      bool copy = (layer->getBlend() == LayerBlend_Opaque) && (layer->getOpacity() >= 1.0f);
+      bool fullRow = (x0 == 0) && (x1 == dst->width);
+      if (!covered && !(copy && fullRow))
+      {
+        for (int x = 0; x < dst->width; ++x)
+          dstRow[x] = mBackground;
+      }
+      covered = true;
+
+      const unsigned int* srcRow = src->data + srcY * (src->pitch / 4) + (x0 - layer->getX());
+      if (copy)
+        memcpy(dstRow + x0, srcRow, (x1 - x0) * 4);
+      else
+      {
+        unsigned int opacity = (unsigned int)(layer->getOpacity() * 256.0f + 0.5f);
+        blendRow(dstRow + x0, srcRow, x1 - x0, opacity, layer->getBlend() == LayerBlend_Alpha);
+      }
+    }
+
+    if (!covered)
+    {
+      for (int x = 0; x < dst->width; ++x)
+        dstRow[x] = mBackground;
+    }
+  }
+}
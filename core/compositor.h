@@ -0,0 +1,95 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "device.h"
+#include "surface.h"
+
+class Layer;
+
+//! Callback that draws the content of a layer into its surface
+typedef void(*LayerRenderCallback)(Layer& layer, ScreenPixelData* pixelData, void* pUserData);
+
+//! How a layer is combined with what is below it
+enum LayerBlend
+{
+  //! Layer pixels replace the pixels below, scaled by the layer opacity
+  LayerBlend_Opaque,
+  //! The alpha channel of every pixel is multiplied with the layer opacity
+  //  Colors must carry an alpha byte, 0x00rrggbb colors are fully transparent.
+  LayerBlend_Alpha,
+};
+
+//! Offscreen surface that is rendered only when it is marked dirty
+class Layer
+{
+public:
+  Layer(const char* cpName, int cWidth, int cHeight, LayerRenderCallback pCallback, void* pUserData);
+
+  //! Request a re-render of the content before the next composite
+  void markDirty() { mDirty = true; }
+
+  //! Access to certain info about the layer
+  const char* getName() const { return mName.c_str(); }
+  int getX() const { return mX; }
+  int getY() const { return mY; }
+  float getOpacity() const { return mOpacity; }
+  LayerBlend getBlend() const { return mBlend; }
+  bool isVisible() const { return mVisible; }
+  bool isDirty() const { return mDirty; }
+  Surface& getSurface() { return mSurface; }
+
+  //! Set layer stuff, these only affect compositing and do not re-render
+  void setPosition(int x, int y) { mX = x; mY = y; }
+  void setOpacity(float opacity) { mOpacity = opacity < 0.0f ? 0.0f : (opacity > 1.0f ? 1.0f : opacity); }
+  void setBlend(LayerBlend blend) { mBlend = blend; }
+  void setVisible(bool visible) { mVisible = visible; }
+
+  //! Change the size, the content is re-rendered
+  void resize(int width, int height);
+
+  //! Render the content if it is dirty
+  // Note: Called by the compositor
+  void update();
+
+private:
+  std::string mName;
+  Surface mSurface;
+  int mX;
+  int mY;
+  float mOpacity;
+  LayerBlend mBlend;
+  bool mVisible;
+  bool mDirty;
+  LayerRenderCallback mRenderCallback;
+  void* mUserData;
+};
+
+//! Stack of named layers that are combined into the presented pixels
+//  Every frame only the dirty layers are rendered again, the rest is reused.
+//  The composite then walks the destination once, row by row, blending all
+//  layers that cover the row while it is in cache.
+class Compositor
+{
+public:
+  Compositor();
+  ~Compositor();
+
+  //! Add a layer on top of the existing ones
+  //  New layers use LayerBlend_Opaque. Switch to LayerBlend_Alpha only when the
+  //  callback draws with colors that have an alpha byte, such as 0xffrrggbb.
+  Layer* addLayer(const char* cpName, int width, int height, LayerRenderCallback pCallback, void* pUserData = nullptr);
+  void removeLayer(const char* cpName);
+  Layer* getLayer(const char* cpName);
+
+  //! Render dirty layers and combine all visible layers into 'dst'
+  void compose(ScreenPixelData* dst);
+
+  //! Color used where no opaque layer covers the destination, in the destination format
+  void setBackground(unsigned int color) { mBackground = color; }
+
+private:
+  //! Layers from bottom to top
+  std::vector<Layer*> mLayers;
+  unsigned int mBackground;
+};
@@ -1,7 +1,36 @@
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
 #include "device.h"
+#include "workerpool.h"
 
 #pragma comment(lib, "d3d11.lib")
 
+//! A readback on its way from the GPU to the caller
+struct PendingReadback
+{
+  //! Progress of the readback
+  enum Stage
+  {
+    Stage_Copy,
+    Stage_Map,
+    Stage_Convert,
+  };
+
+  Stage stage;
+  ReadbackRect rect;
+  ReadbackFormat format;
+  ID3D11Texture2D* texture;
+
+  //! Fulfilled by the worker that converts the pixels, shared with it
+  std::shared_ptr<std::promise<ReadbackImage>> promise;
+
+  //! Only used for callback readbacks, to notice when the conversion finished
+  std::future<ReadbackImage> result;
+  ReadbackCallback callback;
+  void* userData;
+};
+
 //! Constructor
 Device::Device(HWND hWnd)
   : mDxDevice(NULL)
@@ -16,12 +45,15 @@ Device::Device(HWND hWnd)
   , mBackbufferFormat(DXGI_FORMAT_R8G8B8A8_UNORM)
   , mBackbufferCount(2)
   , mSwapchainFlags(0)
+  , mReadbackWorkers(nullptr)
 {
   if (mBackbufferCount > DXGI_MAX_SWAP_CHAIN_BUFFERS)
     mBackbufferCount = DXGI_MAX_SWAP_CHAIN_BUFFERS;
 
   mScreenData.data = nullptr;
   mScreenData.pitch = 0;
+  mScreenData.width = 0;
+  mScreenData.height = 0;
 
   createDevice();
 }
@@ -101,6 +133,7 @@ bool Device::createDevice()
 //! Destroy the device objects
 void Device::destroyDevice()
 {
+  freeReadbacks();
   freeBackBuffer();
 
   if (mDxSwapChain != NULL)
@@ -173,6 +206,8 @@ void Device::mapBackBuffer()
 
   mScreenData.data = (unsigned int*)mapData.pData;
   mScreenData.pitch = mapData.RowPitch;
+  mScreenData.width = mWidth;
+  mScreenData.height = mHeight;
 }
 
 // Unmap the backbuffer
@@ -183,6 +218,8 @@ void Device::unmapBackBuffer()
 
   mScreenData.data = nullptr;
   mScreenData.pitch = 0;
+  mScreenData.width = 0;
+  mScreenData.height = 0;
 }
 
 //! Release the back-buffer texture
@@ -222,6 +259,10 @@ bool Device::present()
     //
     mDxDeviceContext->CopyResource(mDxBackBufferSwapchainTexture, mDxBackBufferWriteTexture[mCurrBackBufferIndex]);
 
+    // Queue the copies of requested readbacks and collect the finished ones
+    copyReadbacks();
+    updateReadbacks();
+
     // Present the backbuffer to the screen
     HRESULT dxResult = mDxSwapChain->Present(0, 0);
     if FAILED(dxResult)
@@ -270,3 +311,207 @@ ScreenPixelData* Device::getPixelData()
     return &mScreenData;
   return nullptr;
 }
+
+//! Queue a readback that is delivered through a future
+std::future<ReadbackImage> Device::requestReadback(const ReadbackRect& rect, ReadbackFormat format)
+{
+  PendingReadback* readback = new PendingReadback();
+  readback->stage = PendingReadback::Stage_Copy;
+  readback->rect = rect;
+  readback->format = format;
+  readback->texture = NULL;
+  readback->callback = nullptr;
+  readback->userData = nullptr;
+  readback->promise = std::make_shared<std::promise<ReadbackImage>>();
+
+  std::future<ReadbackImage> future = readback->promise->get_future();
+  mReadbacks.push_back(readback);
+  return future;
+}
+
+//! Queue a readback that is delivered through a callback
+void Device::requestReadback(const ReadbackRect& rect, ReadbackFormat format, ReadbackCallback pCallback, void* pUserData)
+{
+  PendingReadback* readback = new PendingReadback();
+  readback->stage = PendingReadback::Stage_Copy;
+  readback->rect = rect;
+  readback->format = format;
+  readback->texture = NULL;
+  readback->callback = pCallback;
+  readback->userData = pUserData;
+  readback->promise = std::make_shared<std::promise<ReadbackImage>>();
+  readback->result = readback->promise->get_future();
+  mReadbacks.push_back(readback);
+}
+
+//! Copy the frame that is being presented into readback textures
+void Device::copyReadbacks()
+{
+  for (size_t i = 0; i < mReadbacks.size(); ++i)
+  {
+    PendingReadback* readback = mReadbacks[i];
+    if (readback->stage != PendingReadback::Stage_Copy)
+      continue;
+
+    // Clip the region to the frame
+    ReadbackRect& rect = readback->rect;
+    int x0 = rect.x < 0 ? 0 : rect.x;
+    int y0 = rect.y < 0 ? 0 : rect.y;
+    int x1 = (rect.width > 0) ? (rect.x + rect.width) : mWidth;
+    int y1 = (rect.height > 0) ? (rect.y + rect.height) : mHeight;
+    x1 = x1 > mWidth ? mWidth : x1;
+    y1 = y1 > mHeight ? mHeight : y1;
+    if ((x0 >= x1) || (y0 >= y1))
+    {
+      printf("Readback region is outside of the frame\n");
+      readback->promise->set_exception(std::make_exception_ptr(std::out_of_range("readback region")));
+      readback->stage = PendingReadback::Stage_Convert;
+      continue;
+    }
+
+    rect.x = x0;
+    rect.y = y0;
+    rect.width = x1 - x0;
+    rect.height = y1 - y0;
+
+    // Texture the CPU can read, only as big as the region
+    D3D11_TEXTURE2D_DESC textureDesc;
+    textureDesc.Width = (UINT)rect.width;
+    textureDesc.Height = (UINT)rect.height;
+    textureDesc.MipLevels = 1;
+    textureDesc.ArraySize = 1;
+    textureDesc.Format = mBackbufferFormat;
+    textureDesc.SampleDesc.Count = 1;
+    textureDesc.SampleDesc.Quality = 0;
+    textureDesc.Usage = D3D11_USAGE_STAGING;
+    textureDesc.BindFlags = 0;
+    textureDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    textureDesc.MiscFlags = 0;
+
+    HRESULT dxResult = mDxDevice->CreateTexture2D(&textureDesc, NULL, &readback->texture);
+    if FAILED(dxResult)
+    {
+      printf("DirectX readback CreateTexture2D() failed with code: %i\n", dxResult);
+      readback->promise->set_exception(std::make_exception_ptr(std::runtime_error("readback texture")));
+      readback->stage = PendingReadback::Stage_Convert;
+      continue;
+    }
+
+    D3D11_BOX box;
+    box.left = (UINT)x0;
+    box.top = (UINT)y0;
+    box.front = 0;
+    box.right = (UINT)x1;
+    box.bottom = (UINT)y1;
+    box.back = 1;
+    mDxDeviceContext->CopySubresourceRegion(readback->texture, 0, 0, 0, 0, mDxBackBufferWriteTexture[mCurrBackBufferIndex], 0, &box);
+
+    readback->stage = PendingReadback::Stage_Map;
+  }
+}
+
+//! Map copied readbacks that the GPU finished and deliver converted ones
+void Device::updateReadbacks()
+{
+  for (size_t i = 0; i < mReadbacks.size(); )
+  {
+    PendingReadback* readback = mReadbacks[i];
+
+    if (readback->stage == PendingReadback::Stage_Map)
+    {
+      // Never wait for the GPU, try again on the next present
+      D3D11_MAPPED_SUBRESOURCE mapData;
+      HRESULT dxResult = mDxDeviceContext->Map(readback->texture, 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapData);
+      if (dxResult == DXGI_ERROR_WAS_STILL_DRAWING)
+      {
+        ++i;
+        continue;
+      }
+
+      if FAILED(dxResult)
+      {
+        printf("DirectX readback Map() failed with code: %i\n", dxResult);
+        readback->promise->set_exception(std::make_exception_ptr(std::runtime_error("readback map")));
+      }
+      else
+      {
+        // Take a plain copy of the rows, the conversion runs on a worker
+        int width = readback->rect.width;
+        int height = readback->rect.height;
+        std::shared_ptr<std::vector<unsigned int>> snapshot = std::make_shared<std::vector<unsigned int>>((size_t)width * height);
+        for (int y = 0; y < height; ++y)
+          memcpy(snapshot->data() + (size_t)y * width, (const unsigned char*)mapData.pData + (size_t)y * mapData.RowPitch, width * 4);
+
+        mDxDeviceContext->Unmap(readback->texture, 0);
+
+        if (mReadbackWorkers == nullptr)
+          mReadbackWorkers = new WorkerPool(1);
+
+        ReadbackFormat format = readback->format;
+        std::shared_ptr<std::promise<ReadbackImage>> promise = readback->promise;
+        mReadbackWorkers->submit([snapshot, width, height, format, promise]()
+        {
+          ReadbackImage image;
+          convertReadback(snapshot->data(), width * 4, width, height, format, image);
+          promise->set_value(std::move(image));
+        });
+      }
+
+      readback->texture->Release();
+      readback->texture = NULL;
+      readback->stage = PendingReadback::Stage_Convert;
+    }
+
+    if (readback->stage == PendingReadback::Stage_Convert)
+    {
+      // Future readbacks are done once handed to the worker, callbacks wait for the result
+      if (readback->callback != nullptr)
+      {
+        if (readback->result.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+          ++i;
+          continue;
+        }
+
+        ReadbackImage image;
+        bool succeeded = true;
+        try
+        {
+          image = readback->result.get();
+        }
+        catch (const std::exception& e)
+        {
+          printf("Readback failed: %s\n", e.what());
+          succeeded = false;
+        }
+
+        if (succeeded)
+          readback->callback(image, readback->userData);
+      }
+
+      delete readback;
+      mReadbacks.erase(mReadbacks.begin() + i);
+      continue;
+    }
+
+    ++i;
+  }
+}
+
+//! Release all readbacks, the conversions that are running are finished first
+void Device::freeReadbacks()
+{
+  if (mReadbackWorkers != nullptr)
+  {
+    delete mReadbackWorkers;
+    mReadbackWorkers = nullptr;
+  }
+
+  for (size_t i = 0; i < mReadbacks.size(); ++i)
+  {
+    if (mReadbacks[i]->texture != NULL)
+      mReadbacks[i]->texture->Release();
+    delete mReadbacks[i];
+  }
+  mReadbacks.clear();
+}
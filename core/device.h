@@ -1,8 +1,14 @@
 #pragma once
 
+#include <future>
 #include <string>
+#include <vector>
 #include <Windows.h>
 #include <D3D11.h>
+#include "readback.h"
+
+class WorkerPool;
+struct PendingReadback;
 
 //! Access to the screen pixels
 struct ScreenPixelData
@@ -11,6 +17,9 @@ struct ScreenPixelData
   unsigned int* data;
   //! Size in bytes from one row of pixels to the the next row
   int pitch;
+  //! Dimensions in pixels
+  int width;
+  int height;
 };
 
 class Device
@@ -24,6 +33,13 @@ public:
 
   ScreenPixelData* getPixelData();
 
+  //! Read back a region of the next presented frame
+  //  The frame is copied on the GPU during present() and mapped without waiting
+  //  in a later present(), the format conversion runs on a worker thread.
+  //  Callbacks are called from present() on the thread that presents.
+  std::future<ReadbackImage> requestReadback(const ReadbackRect& rect, ReadbackFormat format);
+  void requestReadback(const ReadbackRect& rect, ReadbackFormat format, ReadbackCallback pCallback, void* pUserData);
+
 private:
   bool createDevice();
   void destroyDevice();
@@ -31,6 +47,9 @@ private:
   void freeBackBuffer();
   void mapBackBuffer();
   void unmapBackBuffer();
+  void copyReadbacks();
+  void updateReadbacks();
+  void freeReadbacks();
 
 private:
   ID3D11Device* mDxDevice;
@@ -46,4 +65,6 @@ private:
   DXGI_FORMAT mBackbufferFormat;
   UINT mBackbufferCount;
   UINT mSwapchainFlags;
+  std::vector<PendingReadback*> mReadbacks;
+  WorkerPool* mReadbackWorkers;
 };
\ No newline at end of file
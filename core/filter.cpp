@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <vector>
+#include <emmintrin.h>
+#include "filter.h"
+#include "workerpool.h"
+
+namespace
+{
+  //! Rows per band below which a pass is not worth splitting
+  const int MinRowsPerBand = 32;
+
+  //! Block of pixels that a pass reads from or writes to
+  struct FilterImage
+  {
+    unsigned int* data;
+    int stride;
+  };
+
+  //! Unpack a pixel to 4 integer channels
+  inline __m128i loadPixelInt(unsigned int pixel)
+  {
+    __m128i zero = _mm_setzero_si128();
+    return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128((int)pixel), zero), zero);
+  }
+
+  //! Unpack a pixel to 4 float channels
+  inline __m128 loadPixel(unsigned int pixel)
+  {
+    return _mm_cvtepi32_ps(loadPixelInt(pixel));
+  }
+
+  //! Pack 4 float channels to a pixel, with rounding and saturation
+  inline unsigned int storePixel(__m128 channels)
+  {
+    __m128i wide = _mm_cvtps_epi32(channels);
+    __m128i packed = _mm_packs_epi32(wide, wide);
+    return (unsigned int)_mm_cvtsi128_si32(_mm_packus_epi16(packed, packed));
+  }
+
+  //! Sliding window average, constant cost per pixel regardless of the radius
+  //  The window sum is kept in integers, only the division goes through floats.
+  struct BoxKernel
+  {
+    int radius;
+
+    void run(const unsigned int* src, unsigned int* dst, int dstStep, int length) const
+    {
+      const __m128 scale = _mm_set1_ps(1.0f / (float)(2 * radius + 1));
+      const int last = length - 1;
+
+      // Window around the first pixel, with the left edge clamped
+      __m128i first = loadPixelInt(src[0]);
+      __m128i sum = _mm_setzero_si128();
+      for (int i = -radius; i <= radius; ++i)
+        sum = _mm_add_epi32(sum, (i <= 0) ? first : loadPixelInt(src[i < last ? i : last]));
+
+      for (int i = 0; i < length; ++i)
+      {
+        dst[i * dstStep] = storePixel(_mm_mul_ps(_mm_cvtepi32_ps(sum), scale));
+
+        int in = i + radius + 1;
+        int out = i - radius;
+        sum = _mm_add_epi32(sum, loadPixelInt(src[in < last ? in : last]));
+        sum = _mm_sub_epi32(sum, loadPixelInt(src[out > 0 ? out : 0]));
+      }
+    }
+  };
+
+  //! Arbitrary weights
+  struct ConvolutionKernel
+  {
+    const float* weights;
+    int radius;
+
+    void run(const unsigned int* src, unsigned int* dst, int dstStep, int length) const
+    {
+      const int last = length - 1;
+      for (int i = 0; i < length; ++i)
+      {
+        __m128 sum = _mm_setzero_ps();
+        for (int k = -radius; k <= radius; ++k)
+        {
+          int index = i + k;
+          index = index < 0 ? 0 : (index > last ? last : index);
+          sum = _mm_add_ps(sum, _mm_mul_ps(loadPixel(src[index]), _mm_set1_ps(weights[k + radius])));
+        }
+        dst[i * dstStep] = storePixel(sum);
+      }
+    }
+  };
+
+  //! Threads shared by all passes of all filters
+  //  Starting threads for every pass costs more than a pass over a small rectangle.
+  WorkerPool& getFilterWorkers()
+  {
+    static WorkerPool workers;
+    return workers;
+  }
+
+  //! Run a kernel over every row of 'src', writing rows or transposed rows to 'dst'
+  template<class Kernel>
+  void runPass(const Kernel& kernel, FilterImage src, FilterImage dst, int rowCount, int rowLength, bool transpose)
+  {
+    auto runBand = [&](int row0, int row1)
+    {
+      for (int row = row0; row < row1; ++row)
+      {
+        const unsigned int* in = src.data + (size_t)row * src.stride;
+        if (transpose)
+          kernel.run(in, dst.data + row, dst.stride, rowLength);
+        else
+          kernel.run(in, dst.data + (size_t)row * dst.stride, 1, rowLength);
+      }
+    };
+
+    WorkerPool& workers = getFilterWorkers();
+    int bandCount = workers.getThreadCount() + 1;
+    bandCount = std::min(bandCount, rowCount / MinRowsPerBand);
+    if (bandCount <= 1)
+    {
+      runBand(0, rowCount);
+      return;
+    }
+
+    // Bands differ by at most one row and end exactly at 'rowCount', the
+    // calling thread takes the last band
+    auto bandStart = [rowCount, bandCount](int band) { return (int)((long long)rowCount * band / bandCount); };
+
+    std::vector<std::future<void>> bands;
+    for (int band = 0; band < bandCount - 1; ++band)
+    {
+      int rowBegin = bandStart(band);
+      int rowEnd = bandStart(band + 1);
+      bands.push_back(workers.submit([&runBand, rowBegin, rowEnd]() { runBand(rowBegin, rowEnd); }));
+    }
+
+    runBand(bandStart(bandCount - 1), rowCount);
+
+    for (size_t i = 0; i < bands.size(); ++i)
+      bands[i].wait();
+  }
+
+  //! Clip the rectangle to the pixel data, returns false if nothing is left
+  bool clipRect(const ScreenPixelData* pixelData, int& x, int& y, int& width, int& height)
+  {
+    if ((pixelData == nullptr) || (pixelData->data == nullptr))
+      return false;
+
+    int x1 = std::min(x + width, pixelData->width);
+    int y1 = std::min(y + height, pixelData->height);
+    x = std::max(x, 0);
+    y = std::max(y, 0);
+    width = x1 - x;
+    height = y1 - y;
+    return (width > 0) && (height > 0);
+  }
+
+  //! Apply the horizontal kernels and then the vertical kernels to a rectangle
+  //  Intermediate passes ping-pong between two scratch buffers, the last
+  //  horizontal pass transposes into a scratch buffer and the last vertical
+  //  pass transposes back into the image.
+  template<class KernelX, class KernelY>
+  void runSeparable(ScreenPixelData* pixelData, int x, int y, int width, int height,
+                    const KernelX* pKernelsX, int countX, const KernelY* pKernelsY, int countY)
+  {
+    std::vector<unsigned int> bufferA((size_t)width * height);
+    std::vector<unsigned int> bufferB((size_t)width * height);
+
+    // Returns a scratch buffer that is not 'src'
+    auto scratch = [&](const FilterImage& src, int stride)
+    {
+      FilterImage image = { (src.data == bufferA.data()) ? bufferB.data() : bufferA.data(), stride };
+      return image;
+    };
+
+    FilterImage image = { pixelData->data + (size_t)y * (pixelData->pitch / 4) + x, pixelData->pitch / 4 };
+
+    // Horizontal, rows of 'width' pixels
+    FilterImage src = image;
+    for (int i = 0; i < countX; ++i)
+    {
+      bool last = (i == countX - 1);
+      FilterImage dst = scratch(src, last ? height : width);
+      runPass(pKernelsX[i], src, dst, height, width, last);
+      src = dst;
+    }
+
+    // Vertical, rows of 'height' pixels
+    for (int i = 0; i < countY; ++i)
+    {
+      bool last = (i == countY - 1);
+      FilterImage dst = last ? image : scratch(src, height);
+      runPass(pKernelsY[i], src, dst, width, height, last);
+      src = dst;
+    }
+  }
+}
+
+//! Box blur
+void boxBlur(ScreenPixelData* pixelData, int xOffset, int yOffset, int width, int height, int radius)
+{
+  if ((radius <= 0) || !clipRect(pixelData, xOffset, yOffset, width, height))
+    return;
+
+  BoxKernel kernel = { radius };
+  runSeparable(pixelData, xOffset, yOffset, width, height, &kernel, 1, &kernel, 1);
+}
+
+//! Gaussian blur through three box blurs
+//  The box sizes follow "Fast Almost-Gaussian Filtering" (Kovesi), picking
+//  widths around the ideal one so the summed variance matches sigma.
+void gaussianBlur(ScreenPixelData* pixelData, int xOffset, int yOffset, int width, int height, float sigma)
+{
+  if ((sigma <= 0.0f) || !clipRect(pixelData, xOffset, yOffset, width, height))
+    return;
+
+  const int passes = 3;
+  float idealWidth = sqrtf(12.0f * sigma * sigma / passes + 1.0f);
+  int lowerWidth = (int)floorf(idealWidth);
+  if ((lowerWidth % 2) == 0)
+    lowerWidth--;
+  int upperWidth = lowerWidth + 2;
+
+  float idealLower = (12.0f * sigma * sigma - passes * lowerWidth * lowerWidth - 4.0f * passes * lowerWidth - 3.0f * passes) / (-4.0f * lowerWidth - 4.0f);
+  int lowerCount = (int)roundf(idealLower);
+
+  BoxKernel kernels[passes];
+  for (int i = 0; i < passes; ++i)
+    kernels[i].radius = ((i < lowerCount) ? lowerWidth : upperWidth) / 2;
+
+  runSeparable(pixelData, xOffset, yOffset, width, height, kernels, passes, kernels, passes);
+}
+
+//! Separable convolution
+void convolveSeparable(ScreenPixelData* pixelData, int xOffset, int yOffset, int width, int height,
+                       const float* pKernelX, const float* pKernelY, int radius)
+{
+  if ((radius < 0) || !clipRect(pixelData, xOffset, yOffset, width, height))
+    return;
+
+  ConvolutionKernel kernelX = { pKernelX, radius };
+  ConvolutionKernel kernelY = { pKernelY, radius };
+  runSeparable(pixelData, xOffset, yOffset, width, height, &kernelX, 1, &kernelY, 1);
+}
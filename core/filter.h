@@ -0,0 +1,20 @@
+#pragma once
+
+#include "device.h"
+
+//! Blur and convolution filters on a rectangle of pixels
+//  All filters are separable and run as two one dimensional passes. Every
+//  pass reads rows and writes them transposed, so the vertical pass also
+//  walks memory row by row. Rows are split into bands that run on a shared
+//  worker pool. All 4 channels of a pixel are processed in one SSE register.
+//  Edges are clamped, pixels outside of the rectangle are never read.
+
+//! Box blur with a (2 * radius + 1) wide window
+void boxBlur(ScreenPixelData* pixelData, int xOffset, int yOffset, int width, int height, int radius);
+
+//! Gaussian blur, approximated with three box blurs of matching variance
+void gaussianBlur(ScreenPixelData* pixelData, int xOffset, int yOffset, int width, int height, float sigma);
+
+//! Convolution with a separable kernel of (2 * radius + 1) weights per axis
+void convolveSeparable(ScreenPixelData* pixelData, int xOffset, int yOffset, int width, int height,
+                       const float* pKernelX, const float* pKernelY, int radius);
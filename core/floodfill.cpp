@@ -0,0 +1,147 @@
+#include <vector>
+#include "floodfill.h"
+
+namespace
+{
+  //! Seed of a run that still has to be expanded
+  struct FloodSeed
+  {
+    int x;
+    int y;
+  };
+
+  //! Compares pixels against the seed color
+  class FloodMatcher
+  {
+  public:
+    FloodMatcher(const ScreenPixelData* pixelData, unsigned int seedColor, int tolerance)
+      : mData(pixelData->data)
+      , mStride(pixelData->pitch / 4)
+      , mSeedColor(seedColor)
+      , mTolerance(tolerance)
+    {
+    }
+
+    bool matches(int x, int y) const
+    {
+      unsigned int color = mData[x + y * mStride];
+
+      // The alpha byte is the top byte in all supported pixel formats
+      if (mTolerance == 0)
+        return ((color ^ mSeedColor) & 0x00FFFFFF) == 0;
+
+      for (int c = 0; c < 24; c += 8)
+      {
+        int diff = (int)((color >> c) & 0xFF) - (int)((mSeedColor >> c) & 0xFF);
+        if ((diff > mTolerance) || (-diff > mTolerance))
+          return false;
+      }
+      return true;
+    }
+
+  private:
+    const unsigned int* mData;
+    int mStride;
+    unsigned int mSeedColor;
+    int mTolerance;
+  };
+
+  //! One bit per pixel to remember which pixels were claimed
+  class FloodVisited
+  {
+  public:
+    FloodVisited(int width, int height)
+      : mWidth(width)
+      , mBits(((size_t)width * height + 31) / 32, 0)
+    {
+    }
+
+    bool isSet(int x, int y) const
+    {
+      size_t index = (size_t)y * mWidth + x;
+      return (mBits[index >> 5] & (1u << (index & 31))) != 0;
+    }
+
+    void set(int x, int y)
+    {
+      size_t index = (size_t)y * mWidth + x;
+      mBits[index >> 5] |= (1u << (index & 31));
+    }
+
+  private:
+    int mWidth;
+    std::vector<unsigned int> mBits;
+  };
+}
+
+//! Scanline seed fill
+Region floodRegion(const ScreenPixelData* pixelData, int seedX, int seedY, int tolerance, FloodConnectivity connectivity)
+{
+  std::vector<RegionRowSpan> spans;
+
+  if ((pixelData == nullptr) || (pixelData->data == nullptr))
+    return Region();
+
+  const int width = pixelData->width;
+  const int height = pixelData->height;
+  if ((seedX < 0) || (seedY < 0) || (seedX >= width) || (seedY >= height))
+    return Region();
+
+  FloodMatcher matcher(pixelData, pixelData->data[seedX + seedY * (pixelData->pitch / 4)], tolerance);
+  FloodVisited visited(width, height);
+
+  // Diagonal neighbours extend the range of the rows above and below by one
+  const int reach = (connectivity == FloodConnectivity_8) ? 1 : 0;
+
+  std::vector<FloodSeed> stack;
+  FloodSeed first = { seedX, seedY };
+  stack.push_back(first);
+
+  while (!stack.empty())
+  {
+    FloodSeed seed = stack.back();
+    stack.pop_back();
+
+    if (visited.isSet(seed.x, seed.y))
+      continue;
+
+    // Grow the run to the left and right
+    int x0 = seed.x;
+    while ((x0 > 0) && !visited.isSet(x0 - 1, seed.y) && matcher.matches(x0 - 1, seed.y))
+      x0--;
+
+    int x1 = seed.x + 1;
+    while ((x1 < width) && !visited.isSet(x1, seed.y) && matcher.matches(x1, seed.y))
+      x1++;
+
+    for (int x = x0; x < x1; ++x)
+      visited.set(x, seed.y);
+
+    RegionRowSpan span = { seed.y, x0, x1 };
+    spans.push_back(span);
+
+    // Push one seed for every unclaimed run in the rows above and below
+    int scanX0 = (x0 - reach) < 0 ? 0 : (x0 - reach);
+    int scanX1 = (x1 + reach) > width ? width : (x1 + reach);
+    for (int dy = -1; dy <= 1; dy += 2)
+    {
+      int y = seed.y + dy;
+      if ((y < 0) || (y >= height))
+        continue;
+
+      bool inRun = false;
+      for (int x = scanX0; x < scanX1; ++x)
+      {
+        bool open = !visited.isSet(x, y) && matcher.matches(x, y);
+        if (open && !inRun)
+        {
+          FloodSeed next = { x, y };
+          stack.push_back(next);
+        }
+        inRun = open;
+      }
+    }
+  }
+
+  return Region::fromSpans(spans);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "device.h"
+#include "region.h"
+
+//! Which neighbours count as connected during a flood fill
+enum FloodConnectivity
+{
+  FloodConnectivity_4,
+  FloodConnectivity_8,
+};
+
+//! Collect the pixels connected to the seed pixel whose color is within
+//! 'tolerance' (per color channel, alpha is ignored) of the seed color
+//  Scanline based: whole runs are claimed at once and only one seed per run of
+//  the neighbouring rows goes onto an explicit stack, so there is no recursion
+//  and memory stays bounded by a visited bitmap plus the pending runs.
+Region floodRegion(const ScreenPixelData* pixelData, int seedX, int seedY, int tolerance, FloodConnectivity connectivity = FloodConnectivity_4);
+
+//! Flood fill from the seed pixel with a span shader
+//  The region is collected before anything is written, so the fill color may
+//  match the tolerance without leaking.
+template<class Shader>
+void floodFill(ScreenPixelData* pixelData, int seedX, int seedY, int tolerance, FloodConnectivity connectivity, const Shader& shader)
+{
+  if (pixelData == nullptr)
+    return;
+
+  Region region = floodRegion(pixelData, seedX, seedY, tolerance, connectivity);
+  fillRegion(pixelData, region, shader);
+}
@@ -0,0 +1,255 @@
+#include <cmath>
+#include <emmintrin.h>
+#include "particles.h"
+
+//! Constructor
+ParticleSystem::ParticleSystem()
+{
+  buildStamps();
+}
+
+//! Add a particle
+int ParticleSystem::add(float x, float y, float velX, float velY, float radius, unsigned int color)
+{
+  mPosX.push_back(x);
+  mPosY.push_back(y);
+  mVelX.push_back(velX);
+  mVelY.push_back(velY);
+  mRadius.push_back(radius);
+  mColor.push_back(color);
+  return (int)mPosX.size() - 1;
+}
+
+//! Copy particles from arrays
+void ParticleSystem::assign(int count, const float* pPosX, const float* pPosY, const float* pVelX, const float* pVelY, const float* pRadius, const unsigned int* pColor)
+{
+  mPosX.assign(pPosX, pPosX + count);
+  mPosY.assign(pPosY, pPosY + count);
+  mRadius.assign(pRadius, pRadius + count);
+  mColor.assign(pColor, pColor + count);
+
+  if (pVelX != nullptr)
+    mVelX.assign(pVelX, pVelX + count);
+  else
+    mVelX.assign(count, 0.0f);
+
+  if (pVelY != nullptr)
+    mVelY.assign(pVelY, pVelY + count);
+  else
+    mVelY.assign(count, 0.0f);
+}
+
+//! Remove all particles
+void ParticleSystem::clear()
+{
+  mPosX.clear();
+  mPosY.clear();
+  mVelX.clear();
+  mVelY.clear();
+  mRadius.clear();
+  mColor.clear();
+}
+
+//! Integrate velocities and positions, 4 particles at a time
+void ParticleSystem::update(float deltaTime, float gravityX, float gravityY, float boundsWidth, float boundsHeight)
+{
+  const int count = getCount();
+  float* posX = mPosX.data();
+  float* posY = mPosY.data();
+  float* velX = mVelX.data();
+  float* velY = mVelY.data();
+
+  const __m128 dt = _mm_set1_ps(deltaTime);
+  const __m128 accelX = _mm_set1_ps(gravityX * deltaTime);
+  const __m128 accelY = _mm_set1_ps(gravityY * deltaTime);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 maxX = _mm_set1_ps(boundsWidth);
+  const __m128 maxY = _mm_set1_ps(boundsHeight);
+  const __m128 signBit = _mm_set1_ps(-0.0f);
+
+  int i = 0;
+  for (; i + 4 <= count; i += 4)
+  {
+    __m128 vx = _mm_add_ps(_mm_loadu_ps(velX + i), accelX);
+    __m128 vy = _mm_add_ps(_mm_loadu_ps(velY + i), accelY);
+    __m128 px = _mm_add_ps(_mm_loadu_ps(posX + i), _mm_mul_ps(vx, dt));
+    __m128 py = _mm_add_ps(_mm_loadu_ps(posY + i), _mm_mul_ps(vy, dt));
+
+    // Flip the velocity of particles that left the bounds and clamp them back in
+    __m128 outX = _mm_or_ps(_mm_cmplt_ps(px, zero), _mm_cmpgt_ps(px, maxX));
+    __m128 outY = _mm_or_ps(_mm_cmplt_ps(py, zero), _mm_cmpgt_ps(py, maxY));
+    vx = _mm_xor_ps(vx, _mm_and_ps(outX, signBit));
+    vy = _mm_xor_ps(vy, _mm_and_ps(outY, signBit));
+    px = _mm_min_ps(_mm_max_ps(px, zero), maxX);
+    py = _mm_min_ps(_mm_max_ps(py, zero), maxY);
+
+    _mm_storeu_ps(velX + i, vx);
+    _mm_storeu_ps(velY + i, vy);
+    _mm_storeu_ps(posX + i, px);
+    _mm_storeu_ps(posY + i, py);
+  }
+
+  for (; i < count; ++i)
+  {
+    velX[i] += gravityX * deltaTime;
+    velY[i] += gravityY * deltaTime;
+    posX[i] += velX[i] * deltaTime;
+    posY[i] += velY[i] * deltaTime;
+
+    if ((posX[i] < 0.0f) || (posX[i] > boundsWidth))
+      velX[i] = -velX[i];
+    if ((posY[i] < 0.0f) || (posY[i] > boundsHeight))
+      velY[i] = -velY[i];
+
+    posX[i] = posX[i] < 0.0f ? 0.0f : (posX[i] > boundsWidth ? boundsWidth : posX[i]);
+    posY[i] = posY[i] < 0.0f ? 0.0f : (posY[i] > boundsHeight ? boundsHeight : posY[i]);
+  }
+}
+
+//! Draw the particles tile by tile
+void ParticleSystem::render(ScreenPixelData* pixelData)
+{
+  if ((pixelData == nullptr) || (pixelData->data == nullptr) || mPosX.empty())
+    return;
+
+  const int width = pixelData->width;
+  const int height = pixelData->height;
+  const int stride = pixelData->pitch / 4;
+  const int binsX = (width + BinSize - 1) >> BinShift;
+
+  binParticles(width, height);
+
+  const int binCount = (int)mBinStarts.size() - 1;
+  for (int bin = 0; bin < binCount; ++bin)
+  {
+    // Clip rectangle of the tile
+    const int clipX0 = (bin % binsX) << BinShift;
+    const int clipY0 = (bin / binsX) << BinShift;
+    const int clipX1 = (clipX0 + BinSize) < width ? (clipX0 + BinSize) : width;
+    const int clipY1 = (clipY0 + BinSize) < height ? (clipY0 + BinSize) : height;
+
+    const ParticleSplat* splat = mBinSplats.data() + mBinStarts[bin];
+    const ParticleSplat* splatEnd = mBinSplats.data() + mBinStarts[bin + 1];
+    for (; splat != splatEnd; ++splat)
+    {
+      const int cx = splat->x;
+      const int cy = splat->y;
+      const int radius = splat->radius;
+      const unsigned int color = splat->color;
+
+      // Single pixel discs are the common case for point clouds
+      if (radius == 0)
+      {
+        pixelData->data[cx + cy * stride] = color;
+        continue;
+      }
+
+      const int* rows = mStampRows.data() + mStampOffsets[radius];
+      int y0 = (cy - radius) < clipY0 ? clipY0 : (cy - radius);
+      int y1 = (cy + radius + 1) > clipY1 ? clipY1 : (cy + radius + 1);
+      for (int y = y0; y < y1; ++y)
+      {
+        int halfWidth = rows[y - cy + radius];
+        int x0 = (cx - halfWidth) < clipX0 ? clipX0 : (cx - halfWidth);
+        int x1 = (cx + halfWidth + 1) > clipX1 ? clipX1 : (cx + halfWidth + 1);
+
+        unsigned int* dst = pixelData->data + y * stride;
+        for (int x = x0; x < x1; ++x)
+          dst[x] = color;
+      }
+    }
+  }
+}
+
+//! Pre-rasterize a stamp for every whole pixel radius
+void ParticleSystem::buildStamps()
+{
+  mStampOffsets.resize(MaxStampRadius + 1);
+  mStampRows.clear();
+
+  for (int radius = 0; radius <= MaxStampRadius; ++radius)
+  {
+    mStampOffsets[radius] = (int)mStampRows.size();
+
+    // Same coverage as fillCircle(): x*x + y*y <= r*r
+    for (int y = -radius; y <= radius; ++y)
+      mStampRows.push_back((int)sqrtf((float)(radius * radius - y * y)));
+  }
+}
+
+//! Counting sort of the particles into the screen tiles they overlap
+//  The splats are written in tile order, so rendering reads them sequentially
+//  instead of gathering from the particle arrays.
+void ParticleSystem::binParticles(int width, int height)
+{
+  const int binsX = (width + BinSize - 1) >> BinShift;
+  const int binsY = (height + BinSize - 1) >> BinShift;
+  const int binCount = binsX * binsY;
+  const int count = getCount();
+
+  mBinStarts.assign(binCount + 1, 0);
+  mParticleSplats.resize(count);
+  mParticleBins.resize(count);
+
+  // Quantize the particles and count them per tile
+  for (int i = 0; i < count; ++i)
+  {
+    ParticleSplat& splat = mParticleSplats[i];
+    int radius = (int)(mRadius[i] + 0.5f);
+    splat.radius = radius < 0 ? 0 : (radius > MaxStampRadius ? MaxStampRadius : radius);
+    splat.x = (int)mPosX[i];
+    splat.y = (int)mPosY[i];
+    splat.color = mColor[i];
+
+    int x0 = splat.x - splat.radius, x1 = splat.x + splat.radius;
+    int y0 = splat.y - splat.radius, y1 = splat.y + splat.radius;
+    if ((x1 < 0) || (y1 < 0) || (x0 >= width) || (y0 >= height))
+    {
+      mParticleBins[i] = -1;
+      continue;
+    }
+
+    // Discs that stay inside one tile are the common case, the others are
+    // counted in every tile they overlap
+    int binX0 = (x0 < 0 ? 0 : x0) >> BinShift;
+    int binX1 = (x1 >= width ? width - 1 : x1) >> BinShift;
+    int binY0 = (y0 < 0 ? 0 : y0) >> BinShift;
+    int binY1 = (y1 >= height ? height - 1 : y1) >> BinShift;
+    if ((binX0 == binX1) && (binY0 == binY1))
+    {
+      mParticleBins[i] = binY0 * binsX + binX0;
+      mBinStarts[mParticleBins[i] + 1]++;
+    }
+    else
+    {
+      mParticleBins[i] = -2;
+      for (int binY = binY0; binY <= binY1; ++binY)
+        for (int binX = binX0; binX <= binX1; ++binX)
+          mBinStarts[binY * binsX + binX + 1]++;
+    }
+  }
+
+  for (int bin = 0; bin < binCount; ++bin)
+    mBinStarts[bin + 1] += mBinStarts[bin];
+
+  // Scatter, keeping the particle order within a tile so overlaps draw in order
+  mBinSplats.resize(mBinStarts[binCount]);
+  mBinFill.assign(mBinStarts.begin(), mBinStarts.end() - 1);
+  for (int i = 0; i < count; ++i)
+  {
+    const ParticleSplat& splat = mParticleSplats[i];
+    int bin = mParticleBins[i];
+    if (bin >= 0)
+      mBinSplats[mBinFill[bin]++] = splat;
+    else if (bin == -2)
+    {
+      int binX0 = ((splat.x - splat.radius) < 0 ? 0 : (splat.x - splat.radius)) >> BinShift;
+      int binX1 = ((splat.x + splat.radius) >= width ? width - 1 : (splat.x + splat.radius)) >> BinShift;
+      int binY0 = ((splat.y - splat.radius) < 0 ? 0 : (splat.y - splat.radius)) >> BinShift;
+      int binY1 = ((splat.y + splat.radius) >= height ? height - 1 : (splat.y + splat.radius)) >> BinShift;
+      for (int binY = binY0; binY <= binY1; ++binY)
+        for (int binX = binX0; binX <= binX1; ++binX)
+          mBinSplats[mBinFill[binY * binsX + binX]++] = splat;
+    }
+  }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+#include "device.h"
+
+//! Quantized particle, ready to be drawn
+struct ParticleSplat
+{
+  int x;
+  int y;
+  int radius;
+  unsigned int color;
+};
+
+//! Large numbers of small discs, stored as structure of arrays
+//  Positions, velocities, radii and colors live in separate arrays so the
+//  update kernel can process 4 particles per SIMD register. Rendering bins the
+//  particles by screen tile first and then splats pre-rasterized stamps (one
+//  per whole pixel radius) tile by tile, so the pixels of a tile stay in cache
+//  while all discs that touch it are drawn.
+class ParticleSystem
+{
+public:
+  //! Screen tiles used for binning, in pixels
+  static const int BinShift = 6;
+  static const int BinSize = 1 << BinShift;
+
+  //! Radii above this are drawn with the largest stamp
+  static const int MaxStampRadius = 32;
+
+  ParticleSystem();
+
+  //! Add a single particle, returns its index
+  int add(float x, float y, float velX, float velY, float radius, unsigned int color);
+
+  //! Replace all particles by copying the arrays, velocities may be null
+  void assign(int count, const float* pPosX, const float* pPosY, const float* pVelX, const float* pVelY, const float* pRadius, const unsigned int* pColor);
+
+  //! Remove all particles
+  void clear();
+
+  //! Move the particles, they bounce off the edges of the bounds
+  void update(float deltaTime, float gravityX, float gravityY, float boundsWidth, float boundsHeight);
+
+  //! Draw all particles, colors are written as is
+  void render(ScreenPixelData* pixelData);
+
+  //! Direct access to the arrays, e.g. for custom update kernels
+  int getCount() const { return (int)mPosX.size(); }
+  float* getPositionsX() { return mPosX.data(); }
+  float* getPositionsY() { return mPosY.data(); }
+  float* getVelocitiesX() { return mVelX.data(); }
+  float* getVelocitiesY() { return mVelY.data(); }
+  float* getRadii() { return mRadius.data(); }
+  unsigned int* getColors() { return mColor.data(); }
+
+private:
+  void buildStamps();
+  void binParticles(int width, int height);
+
+private:
+  //! Particle data
+  std::vector<float> mPosX;
+  std::vector<float> mPosY;
+  std::vector<float> mVelX;
+  std::vector<float> mVelY;
+  std::vector<float> mRadius;
+  std::vector<unsigned int> mColor;
+
+  //! Half width of every row of every stamp, stamp r starts at mStampOffsets[r]
+  std::vector<int> mStampOffsets;
+  std::vector<int> mStampRows;
+
+  //! Quantized particles and the tile they fall in (-1 off screen, -2 several tiles)
+  std::vector<ParticleSplat> mParticleSplats;
+  std::vector<int> mParticleBins;
+
+  //! Splats sorted by tile, tile t owns [mBinStarts[t], mBinStarts[t + 1])
+  std::vector<int> mBinStarts;
+  std::vector<int> mBinFill;
+  std::vector<ParticleSplat> mBinSplats;
+};
@@ -0,0 +1,674 @@
+#include <algorithm>
+#include <cmath>
+#include "path.h"
+
+//! Declare static members
+unsigned int Path::sNextId = 1;
+
+namespace
+{
+  //! Deepest curve subdivision, 2^10 segments per curve
+  const int MaxSubdivisionDepth = 10;
+
+  //! Segments used for a full circle of round joins and caps
+  const int RoundSegments = 16;
+
+  //! Sub-scanlines per pixel row
+  const int CoverageSamples = 4;
+
+  PathPoint makePoint(float x, float y)
+  {
+    PathPoint point = { x, y };
+    return point;
+  }
+
+  PathPoint midPoint(const PathPoint& p0, const PathPoint& p1)
+  {
+    return makePoint((p0.x + p1.x) * 0.5f, (p0.y + p1.y) * 0.5f);
+  }
+
+  //! Squared distance of 'point' to the line through p0 and p1
+  float distanceToChordSq(const PathPoint& point, const PathPoint& p0, const PathPoint& p1)
+  {
+    float dx = p1.x - p0.x;
+    float dy = p1.y - p0.y;
+    float lengthSq = dx * dx + dy * dy;
+    float px = point.x - p0.x;
+    float py = point.y - p0.y;
+    if (lengthSq <= 1e-12f)
+      return px * px + py * py;
+
+    float cross = px * dy - py * dx;
+    return (cross * cross) / lengthSq;
+  }
+
+  //! De Casteljau subdivision of a quadratic curve, appends all points but the first
+  void flattenQuad(const PathPoint& p0, const PathPoint& p1, const PathPoint& p2, float toleranceSq, int depth, std::vector<PathPoint>& out)
+  {
+    if ((depth >= MaxSubdivisionDepth) || (distanceToChordSq(p1, p0, p2) <= toleranceSq))
+    {
+      out.push_back(p2);
+      return;
+    }
+
+    PathPoint p01 = midPoint(p0, p1);
+    PathPoint p12 = midPoint(p1, p2);
+    PathPoint mid = midPoint(p01, p12);
+    flattenQuad(p0, p01, mid, toleranceSq, depth + 1, out);
+    flattenQuad(mid, p12, p2, toleranceSq, depth + 1, out);
+  }
+
+  //! De Casteljau subdivision of a cubic curve, appends all points but the first
+  void flattenCubic(const PathPoint& p0, const PathPoint& p1, const PathPoint& p2, const PathPoint& p3, float toleranceSq, int depth, std::vector<PathPoint>& out)
+  {
+    if ((depth >= MaxSubdivisionDepth) ||
+        ((distanceToChordSq(p1, p0, p3) <= toleranceSq) && (distanceToChordSq(p2, p0, p3) <= toleranceSq)))
+    {
+      out.push_back(p3);
+      return;
+    }
+
+    PathPoint p01 = midPoint(p0, p1);
+    PathPoint p12 = midPoint(p1, p2);
+    PathPoint p23 = midPoint(p2, p3);
+    PathPoint p012 = midPoint(p01, p12);
+    PathPoint p123 = midPoint(p12, p23);
+    PathPoint mid = midPoint(p012, p123);
+    flattenCubic(p0, p01, p012, mid, toleranceSq, depth + 1, out);
+    flattenCubic(mid, p123, p23, p3, toleranceSq, depth + 1, out);
+  }
+
+  //! Append a polygon to the output, flipping it when it is negatively oriented
+  void addPositivePolygon(const PathPoint* pPoints, int count, FlattenedPath& out)
+  {
+    float area = 0.0f;
+    for (int i = 0; i < count; ++i)
+    {
+      const PathPoint& p0 = pPoints[i];
+      const PathPoint& p1 = pPoints[(i + 1) % count];
+      area += p0.x * p1.y - p1.x * p0.y;
+    }
+
+    out.beginContour();
+    if (area >= 0.0f)
+      out.points.insert(out.points.end(), pPoints, pPoints + count);
+    else
+      out.points.insert(out.points.end(), std::reverse_iterator<const PathPoint*>(pPoints + count), std::reverse_iterator<const PathPoint*>(pPoints));
+    out.endContour(true);
+  }
+
+  //! Polygon approximation of a circle
+  void addCircle(const PathPoint& center, float radius, FlattenedPath& out)
+  {
+    PathPoint points[RoundSegments];
+    for (int i = 0; i < RoundSegments; ++i)
+    {
+      float angle = (float)i * (6.2831853f / (float)RoundSegments);
+      points[i] = makePoint(center.x + cosf(angle) * radius, center.y + sinf(angle) * radius);
+    }
+    addPositivePolygon(points, RoundSegments, out);
+  }
+
+  //! Edge of a polygon for the coverage computation, always pointing down
+  struct CoverageEdge
+  {
+    float x0, y0;
+    float x1, y1;
+    float slope;
+    int winding;
+  };
+
+  //! Add [x0, x1) with weight 'weight' to the coverage accumulation of a row
+  void accumulateSpan(float* pAccum, int width, float x0, float x1, float weight)
+  {
+    x0 = x0 < 0.0f ? 0.0f : x0;
+    x1 = x1 > (float)width ? (float)width : x1;
+    if (x0 >= x1)
+      return;
+
+    int ix0 = (int)x0;
+    int ix1 = (int)x1;
+    if (ix0 == ix1)
+    {
+      pAccum[ix0] += (x1 - x0) * weight;
+      return;
+    }
+
+    pAccum[ix0] += ((float)(ix0 + 1) - x0) * weight;
+    for (int x = ix0 + 1; x < ix1; ++x)
+      pAccum[x] += weight;
+    if (ix1 < width)
+      pAccum[ix1] += (x1 - (float)ix1) * weight;
+  }
+}
+
+//! Identity transform
+PathTransform PathTransform::identity()
+{
+  PathTransform transform = { 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f };
+  return transform;
+}
+
+//! Translation transform
+PathTransform PathTransform::translation(float x, float y)
+{
+  PathTransform transform = { 1.0f, 0.0f, 0.0f, 1.0f, x, y };
+  return transform;
+}
+
+//! Scale transform
+PathTransform PathTransform::scale(float x, float y)
+{
+  PathTransform transform = { x, 0.0f, 0.0f, y, 0.0f, 0.0f };
+  return transform;
+}
+
+//! Transform a point
+PathPoint PathTransform::apply(const PathPoint& point) const
+{
+  return makePoint(a * point.x + c * point.y + tx, b * point.x + d * point.y + ty);
+}
+
+//! Exact comparison, used as cache key
+bool PathTransform::operator==(const PathTransform& other) const
+{
+  return (a == other.a) && (b == other.b) && (c == other.c) && (d == other.d) && (tx == other.tx) && (ty == other.ty);
+}
+
+//! Constructor
+Path::Path()
+  : mId(sNextId++)
+  , mVersion(0)
+{
+}
+
+//! Copy constructor, the copy gets its own id since it can be edited independently
+Path::Path(const Path& other)
+  : mId(sNextId++)
+  , mVersion(0)
+  , mVerbs(other.mVerbs)
+  , mPoints(other.mPoints)
+{
+}
+
+//! Assignment, keeps the id but counts as an edit
+Path& Path::operator=(const Path& other)
+{
+  mVerbs = other.mVerbs;
+  mPoints = other.mPoints;
+  mVersion++;
+  return *this;
+}
+
+//! Start a new contour
+void Path::moveTo(float x, float y)
+{
+  mVerbs.push_back(Verb_Move);
+  addPoint(x, y);
+  mVersion++;
+}
+
+//! Straight line from the current point
+void Path::lineTo(float x, float y)
+{
+  mVerbs.push_back(Verb_Line);
+  addPoint(x, y);
+  mVersion++;
+}
+
+//! Quadratic curve from the current point
+void Path::quadTo(float cx, float cy, float x, float y)
+{
+  mVerbs.push_back(Verb_Quad);
+  addPoint(cx, cy);
+  addPoint(x, y);
+  mVersion++;
+}
+
+//! Cubic curve from the current point
+void Path::cubicTo(float c1x, float c1y, float c2x, float c2y, float x, float y)
+{
+  mVerbs.push_back(Verb_Cubic);
+  addPoint(c1x, c1y);
+  addPoint(c2x, c2y);
+  addPoint(x, y);
+  mVersion++;
+}
+
+//! Close the current contour
+void Path::close()
+{
+  mVerbs.push_back(Verb_Close);
+  mVersion++;
+}
+
+//! Remove all contours
+void Path::clear()
+{
+  mVerbs.clear();
+  mPoints.clear();
+  mVersion++;
+}
+
+//! Add a point to the point list
+void Path::addPoint(float x, float y)
+{
+  mPoints.push_back(makePoint(x, y));
+}
+
+//! Reset to no contours
+void FlattenedPath::clear()
+{
+  points.clear();
+  contourStarts.assign(1, 0);
+  contourClosed.clear();
+}
+
+//! Start a contour at the current end of the points
+void FlattenedPath::beginContour()
+{
+  if (contourStarts.empty())
+    contourStarts.push_back((int)points.size());
+}
+
+//! Finish the contour that was started last, empty contours are dropped
+void FlattenedPath::endContour(bool closed)
+{
+  if ((int)points.size() - contourStarts.back() < 2)
+  {
+    points.resize(contourStarts.back());
+    return;
+  }
+
+  contourStarts.push_back((int)points.size());
+  contourClosed.push_back(closed);
+}
+
+//! Flatten the path in screen space
+void flattenPath(const Path& path, const PathTransform& transform, float tolerance, FlattenedPath& out)
+{
+  out.clear();
+
+  const std::vector<Path::Verb>& verbs = path.getVerbs();
+  const std::vector<PathPoint>& points = path.getPoints();
+  const float toleranceSq = tolerance * tolerance;
+
+  PathPoint current = makePoint(0.0f, 0.0f);
+  PathPoint contourStart = current;
+  bool inContour = false;
+  size_t pointIndex = 0;
+
+  for (size_t i = 0; i < verbs.size(); ++i)
+  {
+    switch (verbs[i])
+    {
+    case Path::Verb_Move:
+      if (inContour)
+        out.endContour(false);
+
+      current = transform.apply(points[pointIndex++]);
+      contourStart = current;
+      out.beginContour();
+      out.points.push_back(current);
+      inContour = true;
+      break;
+    case Path::Verb_Line:
+      current = transform.apply(points[pointIndex++]);
+      out.points.push_back(current);
+      break;
+    case Path::Verb_Quad:
+    {
+      // Affine transforms map control points to control points, so transform first
+      PathPoint p1 = transform.apply(points[pointIndex++]);
+      PathPoint p2 = transform.apply(points[pointIndex++]);
+      flattenQuad(current, p1, p2, toleranceSq, 0, out.points);
+      current = p2;
+      break;
+    }
+    case Path::Verb_Cubic:
+    {
+      PathPoint p1 = transform.apply(points[pointIndex++]);
+      PathPoint p2 = transform.apply(points[pointIndex++]);
+      PathPoint p3 = transform.apply(points[pointIndex++]);
+      flattenCubic(current, p1, p2, p3, toleranceSq, 0, out.points);
+      current = p3;
+      break;
+    }
+    case Path::Verb_Close:
+      if (inContour)
+      {
+        // A contour drawn back to its start before closing would keep the start
+        // twice, the zero length segment between them hides the join there
+        float dx = current.x - contourStart.x;
+        float dy = current.y - contourStart.y;
+        if (((int)out.points.size() - out.contourStarts.back() > 1) && (dx * dx + dy * dy <= 1e-12f))
+          out.points.pop_back();
+
+        out.endContour(true);
+      }
+
+      // Drawing continues from the start of the closed contour
+      current = contourStart;
+      out.beginContour();
+      out.points.push_back(current);
+      inContour = true;
+      break;
+    }
+  }
+
+  if (inContour)
+    out.endContour(false);
+
+  // A trailing move or close leaves a single point behind
+  out.points.resize(out.contourStarts.back());
+}
+
+//! Constructor
+PathCache::PathCache(int cCapacity)
+  : mCapacity(cCapacity > 0 ? cCapacity : 1)
+  , mUseCounter(0)
+  , mHits(0)
+  , mMisses(0)
+{
+}
+
+//! Destructor
+PathCache::~PathCache()
+{
+  clear();
+}
+
+//! Look up the flattened path, flatten and store it on a miss
+const FlattenedPath& PathCache::get(const Path& path, const PathTransform& transform, float tolerance)
+{
+  mUseCounter++;
+
+  for (size_t i = 0; i < mEntries.size(); ++i)
+  {
+    Entry& entry = *mEntries[i];
+    if ((entry.pathId == path.getId()) && (entry.pathVersion == path.getVersion()) &&
+        (entry.tolerance == tolerance) && (entry.transform == transform))
+    {
+      entry.lastUse = mUseCounter;
+      mHits++;
+      return entry.flattened;
+    }
+  }
+
+  mMisses++;
+
+  // Reuse the least recently used entry when full
+  Entry* pEntry = nullptr;
+  if ((int)mEntries.size() < mCapacity)
+  {
+    pEntry = new Entry();
+    mEntries.push_back(pEntry);
+  }
+  else
+  {
+    pEntry = mEntries[0];
+    for (size_t i = 1; i < mEntries.size(); ++i)
+    {
+      if (mEntries[i]->lastUse < pEntry->lastUse)
+        pEntry = mEntries[i];
+    }
+  }
+
+  pEntry->pathId = path.getId();
+  pEntry->pathVersion = path.getVersion();
+  pEntry->transform = transform;
+  pEntry->tolerance = tolerance;
+  pEntry->lastUse = mUseCounter;
+  flattenPath(path, transform, tolerance, pEntry->flattened);
+  return pEntry->flattened;
+}
+
+//! Drop all entries
+void PathCache::clear()
+{
+  for (size_t i = 0; i < mEntries.size(); ++i)
+    delete mEntries[i];
+  mEntries.clear();
+}
+
+//! Build the stroke outline as a union of segment quads, joins and caps
+void strokePath(const FlattenedPath& path, const StrokeStyle& style, FlattenedPath& out)
+{
+  out.clear();
+
+  const float halfWidth = style.width * 0.5f;
+  if (halfWidth <= 0.0f)
+    return;
+
+  for (int contour = 0; contour < path.getContourCount(); ++contour)
+  {
+    const PathPoint* points = path.points.data() + path.contourStarts[contour];
+    int count = path.contourStarts[contour + 1] - path.contourStarts[contour];
+    bool closed = path.contourClosed[contour];
+
+    // A closed contour also has the segment back to its first point
+    int segmentCount = closed ? count : count - 1;
+
+    for (int s = 0; s < segmentCount; ++s)
+    {
+      const PathPoint& p0 = points[s];
+      const PathPoint& p1 = points[(s + 1) % count];
+      float dx = p1.x - p0.x;
+      float dy = p1.y - p0.y;
+      float length = sqrtf(dx * dx + dy * dy);
+      if (length <= 1e-6f)
+        continue;
+
+      // Normal of the segment, scaled to half the stroke width
+      float nx = -dy / length * halfWidth;
+      float ny = dx / length * halfWidth;
+
+      // Square caps extend the first and last segment of open contours
+      float ex0 = 0.0f, ey0 = 0.0f, ex1 = 0.0f, ey1 = 0.0f;
+      if (!closed && (style.cap == StrokeCap_Square))
+      {
+        if (s == 0)
+        {
+          ex0 = -dx / length * halfWidth;
+          ey0 = -dy / length * halfWidth;
+        }
+        if (s == segmentCount - 1)
+        {
+          ex1 = dx / length * halfWidth;
+          ey1 = dy / length * halfWidth;
+        }
+      }
+
+      PathPoint quad[4] = {
+        makePoint(p0.x + nx + ex0, p0.y + ny + ey0),
+        makePoint(p1.x + nx + ex1, p1.y + ny + ey1),
+        makePoint(p1.x - nx + ex1, p1.y - ny + ey1),
+        makePoint(p0.x - nx + ex0, p0.y - ny + ey0),
+      };
+      addPositivePolygon(quad, 4, out);
+    }
+
+    // Joins at every interior vertex, and at every vertex of closed contours
+    int firstJoin = closed ? 0 : 1;
+    int lastJoin = closed ? count : count - 1;
+    for (int v = firstJoin; v < lastJoin; ++v)
+    {
+      const PathPoint& prev = points[(v + count - 1) % count];
+      const PathPoint& curr = points[v];
+      const PathPoint& next = points[(v + 1) % count];
+
+      if (style.join == StrokeJoin_Round)
+      {
+        addCircle(curr, halfWidth, out);
+        continue;
+      }
+
+      float d0x = curr.x - prev.x, d0y = curr.y - prev.y;
+      float d1x = next.x - curr.x, d1y = next.y - curr.y;
+      float length0 = sqrtf(d0x * d0x + d0y * d0y);
+      float length1 = sqrtf(d1x * d1x + d1y * d1y);
+      if ((length0 <= 1e-6f) || (length1 <= 1e-6f))
+        continue;
+
+      d0x /= length0; d0y /= length0;
+      d1x /= length1; d1y /= length1;
+
+      // The outer side of the turn is opposite to the turn direction
+      float cross = d0x * d1y - d0y * d1x;
+      if (fabsf(cross) <= 1e-6f)
+        continue;
+
+      float side = cross > 0.0f ? -1.0f : 1.0f;
+      PathPoint outer0 = makePoint(curr.x - d0y * halfWidth * side, curr.y + d0x * halfWidth * side);
+      PathPoint outer1 = makePoint(curr.x - d1y * halfWidth * side, curr.y + d1x * halfWidth * side);
+
+      // Miter length relative to the half width is 1 / cos(theta / 2)
+      float cosHalf = sqrtf((1.0f + d0x * d1x + d0y * d1y) * 0.5f);
+      bool miter = (style.join == StrokeJoin_Miter) && (cosHalf > 1e-6f) && ((1.0f / cosHalf) <= style.miterLimit);
+      if (miter)
+      {
+        float bx = outer0.x + outer1.x - 2.0f * curr.x;
+        float by = outer0.y + outer1.y - 2.0f * curr.y;
+        float bLength = sqrtf(bx * bx + by * by);
+        float miterLength = halfWidth / cosHalf;
+        PathPoint tip = makePoint(curr.x + bx / bLength * miterLength, curr.y + by / bLength * miterLength);
+        PathPoint polygon[4] = { curr, outer0, tip, outer1 };
+        addPositivePolygon(polygon, 4, out);
+      }
+      else
+      {
+        PathPoint polygon[3] = { curr, outer0, outer1 };
+        addPositivePolygon(polygon, 3, out);
+      }
+    }
+
+    // Round caps on both ends of open contours
+    if (!closed && (style.cap == StrokeCap_Round))
+    {
+      addCircle(points[0], halfWidth, out);
+      addCircle(points[count - 1], halfWidth, out);
+    }
+  }
+}
+
+//! Scanline coverage with an active edge list
+void computePathCoverage(const FlattenedPath& path, FillRule rule, int width, int height, PathCoverage& out)
+{
+  out.rows.clear();
+  out.alpha.clear();
+
+  if ((width <= 0) || (height <= 0))
+    return;
+
+  // Collect the edges of all contours, contours are always closed for filling
+  std::vector<CoverageEdge> edges;
+  float minY = (float)height, maxY = 0.0f;
+  for (int contour = 0; contour < path.getContourCount(); ++contour)
+  {
+    const PathPoint* points = path.points.data() + path.contourStarts[contour];
+    int count = path.contourStarts[contour + 1] - path.contourStarts[contour];
+    for (int i = 0; i < count; ++i)
+    {
+      const PathPoint& p0 = points[i];
+      const PathPoint& p1 = points[(i + 1) % count];
+      if (p0.y == p1.y)
+        continue;
+
+      CoverageEdge edge;
+      edge.winding = p0.y < p1.y ? 1 : -1;
+      const PathPoint& top = p0.y < p1.y ? p0 : p1;
+      const PathPoint& bottom = p0.y < p1.y ? p1 : p0;
+      edge.x0 = top.x;
+      edge.y0 = top.y;
+      edge.x1 = bottom.x;
+      edge.y1 = bottom.y;
+      edge.slope = (bottom.x - top.x) / (bottom.y - top.y);
+      edges.push_back(edge);
+
+      minY = top.y < minY ? top.y : minY;
+      maxY = bottom.y > maxY ? bottom.y : maxY;
+    }
+  }
+
+  if (edges.empty())
+    return;
+
+  std::sort(edges.begin(), edges.end(), [](const CoverageEdge& a, const CoverageEdge& b) { return a.y0 < b.y0; });
+
+  int rowY0 = (int)floorf(minY);
+  int rowY1 = (int)ceilf(maxY);
+  rowY0 = rowY0 < 0 ? 0 : rowY0;
+  rowY1 = rowY1 > height ? height : rowY1;
+
+  std::vector<float> accum(width + 1);
+  std::vector<const CoverageEdge*> active;
+  struct Crossing
+  {
+    float x;
+    int winding;
+  };
+  std::vector<Crossing> crossings;
+  size_t nextEdge = 0;
+  const float sampleWeight = 1.0f / (float)CoverageSamples;
+
+  for (int y = rowY0; y < rowY1; ++y)
+  {
+    std::fill(accum.begin(), accum.end(), 0.0f);
+    float spanMin = (float)width, spanMax = 0.0f;
+
+    for (int sample = 0; sample < CoverageSamples; ++sample)
+    {
+      float sampleY = (float)y + ((float)sample + 0.5f) * sampleWeight;
+
+      // Update the active edges for this sub-scanline
+      while ((nextEdge < edges.size()) && (edges[nextEdge].y0 <= sampleY))
+        active.push_back(&edges[nextEdge++]);
+      active.erase(std::remove_if(active.begin(), active.end(),
+        [sampleY](const CoverageEdge* pEdge) { return pEdge->y1 <= sampleY; }), active.end());
+
+      crossings.clear();
+      for (size_t e = 0; e < active.size(); ++e)
+      {
+        const CoverageEdge* pEdge = active[e];
+        if (pEdge->y0 > sampleY)
+          continue;
+
+        Crossing crossing = { pEdge->x0 + (sampleY - pEdge->y0) * pEdge->slope, pEdge->winding };
+        crossings.push_back(crossing);
+      }
+
+      std::sort(crossings.begin(), crossings.end(), [](const Crossing& a, const Crossing& b) { return a.x < b.x; });
+
+      // Walk the crossings and accumulate the inside intervals
+      int winding = 0;
+      for (size_t c = 0; c + 1 < crossings.size(); ++c)
+      {
+        winding += crossings[c].winding;
+        bool inside = (rule == FillRule_NonZero) ? (winding != 0) : ((winding & 1) != 0);
+        if (inside)
+        {
+          accumulateSpan(accum.data(), width, crossings[c].x, crossings[c + 1].x, sampleWeight);
+          spanMin = crossings[c].x < spanMin ? crossings[c].x : spanMin;
+          spanMax = crossings[c + 1].x > spanMax ? crossings[c + 1].x : spanMax;
+        }
+      }
+    }
+
+    // Convert the touched range of the row to alpha
+    int x0 = (int)floorf(spanMin);
+    int x1 = (int)ceilf(spanMax);
+    x0 = x0 < 0 ? 0 : x0;
+    x1 = x1 > width ? width : x1;
+    if (x0 >= x1)
+      continue;
+
+    PathCoverage::Row row = { y, x0, x1, (int)out.alpha.size() };
+    out.rows.push_back(row);
+    for (int x = x0; x < x1; ++x)
+    {
+      float coverage = accum[x];
+      coverage = coverage > 1.0f ? 1.0f : coverage;
+      out.alpha.push_back((unsigned char)(coverage * 255.0f + 0.5f));
+    }
+  }
+}
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <vector>
+#include "device.h"
+
+//! Point or vector in pixel space
+struct PathPoint
+{
+  float x;
+  float y;
+};
+
+//! 2D affine transform: x' = a*x + c*y + tx, y' = b*x + d*y + ty
+struct PathTransform
+{
+  float a, b, c, d, tx, ty;
+
+  static PathTransform identity();
+  static PathTransform translation(float x, float y);
+  static PathTransform scale(float x, float y);
+
+  PathPoint apply(const PathPoint& point) const;
+  bool operator==(const PathTransform& other) const;
+};
+
+//! Path made of lines and quadratic/cubic Bezier curves
+//  Every path has a unique id and a version that changes on every edit, the
+//  pair is what PathCache uses to recognize static paths.
+class Path
+{
+public:
+  //! Commands stored in the path, each consumes points from the point list
+  enum Verb
+  {
+    Verb_Move,   // 1 point
+    Verb_Line,   // 1 point
+    Verb_Quad,   // 2 points
+    Verb_Cubic,  // 3 points
+    Verb_Close,  // 0 points
+  };
+
+  Path();
+  Path(const Path& other);
+  Path& operator=(const Path& other);
+
+  //! Build the path
+  void moveTo(float x, float y);
+  void lineTo(float x, float y);
+  void quadTo(float cx, float cy, float x, float y);
+  void cubicTo(float c1x, float c1y, float c2x, float c2y, float x, float y);
+  void close();
+  void clear();
+
+  //! Access to the path data
+  unsigned int getId() const { return mId; }
+  unsigned int getVersion() const { return mVersion; }
+  const std::vector<Verb>& getVerbs() const { return mVerbs; }
+  const std::vector<PathPoint>& getPoints() const { return mPoints; }
+
+private:
+  void addPoint(float x, float y);
+
+private:
+  static unsigned int sNextId;
+
+  unsigned int mId;
+  unsigned int mVersion;
+  std::vector<Verb> mVerbs;
+  std::vector<PathPoint> mPoints;
+};
+
+//! Path converted to polygons
+struct FlattenedPath
+{
+  //! Points of all contours
+  std::vector<PathPoint> points;
+
+  //! Index of the first point of every contour, with one extra entry at the end
+  std::vector<int> contourStarts;
+
+  //! Whether each contour was closed explicitly
+  std::vector<bool> contourClosed;
+
+  int getContourCount() const { return (int)contourStarts.size() - 1; }
+  void clear();
+  void beginContour();
+  void endContour(bool closed);
+};
+
+//! Convert the curves of a path to line segments after transforming it
+//  Curves are subdivided until the control points are within 'tolerance'
+//  pixels of the chord, so the error is bounded in screen space.
+void flattenPath(const Path& path, const PathTransform& transform, float tolerance, FlattenedPath& out);
+
+//! Caches flattened paths, keyed by path id, path version, transform and tolerance
+//  Entries are allocated individually, so a returned reference stays valid
+//  while other paths are added. It becomes invalid once its entry is evicted
+//  (the least recently used entry is reused when the cache is full), the
+//  cache is cleared or the cache is destroyed.
+class PathCache
+{
+public:
+  PathCache(int cCapacity = 256);
+  ~PathCache();
+
+  //! Returns the flattened path, flattening it only when it is not cached
+  const FlattenedPath& get(const Path& path, const PathTransform& transform, float tolerance = 0.25f);
+
+  //! Drop all entries, invalidates all returned references
+  void clear();
+
+  //! Access to certain info about the cache
+  int getSize() const { return (int)mEntries.size(); }
+  int getHits() const { return mHits; }
+  int getMisses() const { return mMisses; }
+
+private:
+  struct Entry
+  {
+    unsigned int pathId;
+    unsigned int pathVersion;
+    PathTransform transform;
+    float tolerance;
+    unsigned int lastUse;
+    FlattenedPath flattened;
+  };
+
+  //! Caches own their entries, so no copies
+  PathCache(const PathCache&);
+  PathCache& operator=(const PathCache&);
+
+private:
+  int mCapacity;
+  unsigned int mUseCounter;
+  int mHits;
+  int mMisses;
+  std::vector<Entry*> mEntries;
+};
+
+//! How the ends of open contours look
+enum StrokeCap
+{
+  StrokeCap_Butt,
+  StrokeCap_Square,
+  StrokeCap_Round,
+};
+
+//! How segments are connected
+enum StrokeJoin
+{
+  StrokeJoin_Miter,
+  StrokeJoin_Bevel,
+  StrokeJoin_Round,
+};
+
+//! Stroke settings
+struct StrokeStyle
+{
+  float width;
+  StrokeCap cap;
+  StrokeJoin join;
+  float miterLimit;
+};
+
+//! Convert the outline of a flattened path to polygons that cover the stroke
+//  The result is a set of positively oriented polygons, fill it with
+//  FillRule_NonZero.
+void strokePath(const FlattenedPath& path, const StrokeStyle& style, FlattenedPath& out);
+
+//! Rule that decides which parts of overlapping contours are inside
+enum FillRule
+{
+  FillRule_NonZero,
+  FillRule_EvenOdd,
+};
+
+//! Anti-aliased coverage of a filled path, as alpha runs per row
+struct PathCoverage
+{
+  //! A row of coverage values for pixels [x0, x1) of row y
+  struct Row
+  {
+    int y;
+    int x0;
+    int x1;
+    int offset;
+  };
+
+  std::vector<Row> rows;
+  std::vector<unsigned char> alpha;
+};
+
+//! Compute the coverage of a path, clipped to width x height
+//  Every pixel row is sampled at 4 sub-scanlines, the crossings between them
+//  are accumulated with exact horizontal coverage.
+void computePathCoverage(const FlattenedPath& path, FillRule rule, int width, int height, PathCoverage& out);
+
+//! Blend 'src' over 'dst' with a coverage value in [0, 256], per 8 bit channel
+inline unsigned int blendCoverage(unsigned int dst, unsigned int src, unsigned int alpha)
+{
+  unsigned int invAlpha = 256 - alpha;
+  unsigned int rb = (((src & 0x00FF00FF) * alpha + (dst & 0x00FF00FF) * invAlpha) >> 8) & 0x00FF00FF;
+  unsigned int ag = ((((src >> 8) & 0x00FF00FF) * alpha + ((dst >> 8) & 0x00FF00FF) * invAlpha) >> 8) & 0x00FF00FF;
+  return rb | (ag << 8);
+}
+
+//! Fill a path with a span shader (see shader.h)
+//  Fully covered runs are handed to the shader directly, edge pixels are
+//  shaded one at a time and blended by their coverage.
+template<class Shader>
+void fillPath(ScreenPixelData* pixelData, const FlattenedPath& path, FillRule rule, const Shader& shader)
+{
+  if ((pixelData == nullptr) || (pixelData->data == nullptr))
+    return;
+
+  PathCoverage coverage;
+  computePathCoverage(path, rule, pixelData->width, pixelData->height, coverage);
+
+  const int stride = pixelData->pitch / 4;
+  for (size_t r = 0; r < coverage.rows.size(); ++r)
+  {
+    const PathCoverage::Row& row = coverage.rows[r];
+    const unsigned char* alpha = coverage.alpha.data() + row.offset;
+    unsigned int* dst = pixelData->data + row.y * stride;
+
+    int x = row.x0;
+    while (x < row.x1)
+    {
+      unsigned int a = alpha[x - row.x0];
+      if (a == 255)
+      {
+        int runEnd = x + 1;
+        while ((runEnd < row.x1) && (alpha[runEnd - row.x0] == 255))
+          runEnd++;
+
+        shader.shadeSpan(x, row.y, runEnd - x, dst + x);
+        x = runEnd;
+      }
+      else
+      {
+        if (a != 0)
+        {
+          unsigned int color;
+          shader.shadeSpan(x, row.y, 1, &color);
+          dst[x] = blendCoverage(dst[x], color, a + (a >> 7));
+        }
+        x++;
+      }
+    }
+  }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+//! Pixel format policies
+//  Colors are handed around as 0xAARRGGBB (ARGB) values, the pixel format
+//  policies convert them to the layout of the surface that is written to.
+//  They are used as template parameters so the conversion is resolved at compile time.
+
+//! Layout of the device back buffer (DXGI_FORMAT_R8G8B8A8_UNORM)
+struct PixelFormatR8G8B8A8
+{
+  static unsigned int pack(unsigned int r, unsigned int g, unsigned int b, unsigned int a)
+  {
+    return r | (g << 8) | (b << 16) | (a << 24);
+  }
+
+  static unsigned int fromArgb(unsigned int argb)
+  {
+    return (argb & 0xFF00FF00) | ((argb >> 16) & 0xFF) | ((argb & 0xFF) << 16);
+  }
+
+  static unsigned int toArgb(unsigned int pixel)
+  {
+    return fromArgb(pixel);
+  }
+};
+
+//! Layout matching the ARGB color values on little endian machines
+struct PixelFormatB8G8R8A8
+{
+  static unsigned int pack(unsigned int r, unsigned int g, unsigned int b, unsigned int a)
+  {
+    return b | (g << 8) | (r << 16) | (a << 24);
+  }
+
+  static unsigned int fromArgb(unsigned int argb)
+  {
+    return argb;
+  }
+
+  static unsigned int toArgb(unsigned int pixel)
+  {
+    return pixel;
+  }
+};
+
+//! The format the device back buffer uses
+typedef PixelFormatR8G8B8A8 PixelFormatBackBuffer;
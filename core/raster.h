@@ -0,0 +1,68 @@
+#pragma once
+
+#include "device.h"
+#include "shader.h"
+
+//! Shape fills parameterized by a span shader (see shader.h)
+//  All shapes are clipped against the pixel data dimensions and are broken
+//  down into horizontal spans, which the shader fills in one go.
+
+//! Fill a single horizontal span, clipped to the pixel data
+template<class Shader>
+void fillSpan(ScreenPixelData* pixelData, int x, int y, int count, const Shader& shader)
+{
+  if ((y < 0) || (y >= pixelData->height))
+    return;
+
+  int x0 = x < 0 ? 0 : x;
+  int x1 = (x + count) > pixelData->width ? pixelData->width : (x + count);
+  if (x0 >= x1)
+    return;
+
+  unsigned int* row = pixelData->data + y * (pixelData->pitch / 4);
+  shader.shadeSpan(x0, y, x1 - x0, row + x0);
+}
+
+//! Fill an axis aligned rectangle
+template<class Shader>
+void fillRect(ScreenPixelData* pixelData, int xOffset, int yOffset, int width, int height, const Shader& shader)
+{
+  if (pixelData == nullptr)
+    return;
+
+  // Clip once, so the rows can skip the checks
+  int x0 = xOffset < 0 ? 0 : xOffset;
+  int y0 = yOffset < 0 ? 0 : yOffset;
+  int x1 = (xOffset + width) > pixelData->width ? pixelData->width : (xOffset + width);
+  int y1 = (yOffset + height) > pixelData->height ? pixelData->height : (yOffset + height);
+  if ((x0 >= x1) || (y0 >= y1))
+    return;
+
+  unsigned int* row = pixelData->data + y0 * (pixelData->pitch / 4);
+  for (int y = y0; y < y1; ++y)
+  {
+    shader.shadeSpan(x0, y, x1 - x0, row + x0);
+    row += pixelData->pitch / 4;
+  }
+}
+
+//! Fill a circle, covers the same pixels as drawCircleSimple (x*x + y*y <= r*r)
+template<class Shader>
+void fillCircle(ScreenPixelData* pixelData, int xOffset, int yOffset, int radius, const Shader& shader)
+{
+  if ((pixelData == nullptr) || (radius < 0))
+    return;
+
+  // Walk the half width inwards while moving away from the center row
+  int halfWidth = radius;
+  const int radiusSq = radius * radius;
+  for (int y = 0; y <= radius; ++y)
+  {
+    while ((halfWidth * halfWidth) + (y * y) > radiusSq)
+      halfWidth--;
+
+    fillSpan(pixelData, xOffset - halfWidth, yOffset + y, 2 * halfWidth + 1, shader);
+    if (y != 0)
+      fillSpan(pixelData, xOffset - halfWidth, yOffset - y, 2 * halfWidth + 1, shader);
+  }
+}
@@ -0,0 +1,118 @@
+#include <cstring>
+#include <emmintrin.h>
+#include "readback.h"
+
+//! Return the bytes per pixel
+int getReadbackBytesPerPixel(ReadbackFormat format)
+{
+  switch (format)
+  {
+  case ReadbackFormat_RGBA: return 4;
+  case ReadbackFormat_BGRA: return 4;
+  case ReadbackFormat_RGB24: return 3;
+  case ReadbackFormat_Grey: return 1;
+  default: return 4;
+  }
+}
+
+//! Convert a row of pixels
+void convertReadbackRow(const unsigned int* src, int count, ReadbackFormat format, unsigned char* dst)
+{
+  int x = 0;
+
+  switch (format)
+  {
+  case ReadbackFormat_RGBA:
+    memcpy(dst, src, count * 4);
+    return;
+
+  case ReadbackFormat_BGRA:
+  {
+    // Keep green and alpha, swap the bytes of red and blue
+    const __m128i maskAG = _mm_set1_epi32((int)0xFF00FF00);
+    const __m128i maskLow = _mm_set1_epi32(0x000000FF);
+    for (; x + 4 <= count; x += 4)
+    {
+      __m128i pixels = _mm_loadu_si128((const __m128i*)(src + x));
+      __m128i red = _mm_slli_epi32(_mm_and_si128(pixels, maskLow), 16);
+      __m128i blue = _mm_and_si128(_mm_srli_epi32(pixels, 16), maskLow);
+      __m128i result = _mm_or_si128(_mm_and_si128(pixels, maskAG), _mm_or_si128(red, blue));
+      _mm_storeu_si128((__m128i*)(dst + x * 4), result);
+    }
+    for (; x < count; ++x)
+    {
+      unsigned int p = src[x];
+      unsigned int result = (p & 0xFF00FF00) | ((p & 0xFF) << 16) | ((p >> 16) & 0xFF);
+      memcpy(dst + x * 4, &result, 4);
+    }
+    return;
+  }
+
+  case ReadbackFormat_RGB24:
+  {
+    // rgba rgba rgba rgba -> rgbr gbrg brgb
+    for (; x + 4 <= count; x += 4)
+    {
+      unsigned int p0 = src[x], p1 = src[x + 1], p2 = src[x + 2], p3 = src[x + 3];
+      unsigned int words[3] = {
+        (p0 & 0x00FFFFFF) | (p1 << 24),
+        ((p1 >> 8) & 0x0000FFFF) | (p2 << 16),
+        ((p2 >> 16) & 0x000000FF) | (p3 << 8),
+      };
+      memcpy(dst + x * 3, words, 12);
+    }
+    for (; x < count; ++x)
+    {
+      unsigned int p = src[x];
+      dst[x * 3 + 0] = (unsigned char)(p);
+      dst[x * 3 + 1] = (unsigned char)(p >> 8);
+      dst[x * 3 + 2] = (unsigned char)(p >> 16);
+    }
+    return;
+  }
+
+  case ReadbackFormat_Grey:
+  {
+    // Luma = (77 R + 150 G + 29 B) >> 8, two channel pairs per multiply-add
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i weights = _mm_set_epi16(0, 29, 150, 77, 0, 29, 150, 77);
+    for (; x + 4 <= count; x += 4)
+    {
+      __m128i pixels = _mm_loadu_si128((const __m128i*)(src + x));
+      __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), weights);
+      __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), weights);
+
+      // Add the (R,G) and (B,A) partial sums of every pixel
+      __m128i sumLo = _mm_add_epi32(lo, _mm_srli_epi64(lo, 32));
+      __m128i sumHi = _mm_add_epi32(hi, _mm_srli_epi64(hi, 32));
+      __m128i luma = _mm_srli_epi32(_mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(sumLo), _mm_castsi128_ps(sumHi), _MM_SHUFFLE(2, 0, 2, 0))), 8);
+
+      __m128i packed = _mm_packs_epi32(luma, luma);
+      unsigned int result = (unsigned int)_mm_cvtsi128_si32(_mm_packus_epi16(packed, packed));
+      memcpy(dst + x, &result, 4);
+    }
+    for (; x < count; ++x)
+    {
+      unsigned int p = src[x];
+      dst[x] = (unsigned char)((77 * (p & 0xFF) + 150 * ((p >> 8) & 0xFF) + 29 * ((p >> 16) & 0xFF)) >> 8);
+    }
+    return;
+  }
+  }
+}
+
+//! Convert a block of pixels
+void convertReadback(const unsigned int* src, int srcPitch, int width, int height, ReadbackFormat format, ReadbackImage& out)
+{
+  out.width = width;
+  out.height = height;
+  out.format = format;
+  out.pitch = width * getReadbackBytesPerPixel(format);
+  out.pixels.resize((size_t)out.pitch * height);
+
+  for (int y = 0; y < height; ++y)
+  {
+    const unsigned int* srcRow = (const unsigned int*)((const unsigned char*)src + (size_t)y * srcPitch);
+    convertReadbackRow(srcRow, width, format, out.pixels.data() + (size_t)y * out.pitch);
+  }
+}
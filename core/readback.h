@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+
+//! Formats pixels can be read back in
+enum ReadbackFormat
+{
+  //! 4 bytes per pixel, the back buffer layout
+  ReadbackFormat_RGBA,
+  //! 4 bytes per pixel, red and blue swapped
+  ReadbackFormat_BGRA,
+  //! 3 bytes per pixel, no alpha
+  ReadbackFormat_RGB24,
+  //! 1 byte per pixel, Rec. 601 luma
+  ReadbackFormat_Grey,
+};
+
+//! Region of a frame to read back, a width or height of 0 means up to the frame edge
+struct ReadbackRect
+{
+  int x;
+  int y;
+  int width;
+  int height;
+};
+
+//! Pixels read back from a frame
+struct ReadbackImage
+{
+  int width;
+  int height;
+  //! Bytes from one row to the next, rows are tightly packed
+  int pitch;
+  ReadbackFormat format;
+  std::vector<unsigned char> pixels;
+};
+
+//! Callback definition for finished readbacks
+typedef void(*ReadbackCallback)(const ReadbackImage& image, void* pUserData);
+
+//! Bytes per pixel of a readback format
+int getReadbackBytesPerPixel(ReadbackFormat format);
+
+//! Convert 'count' R8G8B8A8 pixels to the requested format
+//  The 4 byte formats and grey are converted 4 pixels per SSE2 register,
+//  RGB24 packs 4 pixels into 3 words.
+void convertReadbackRow(const unsigned int* src, int count, ReadbackFormat format, unsigned char* dst);
+
+//! Convert a block of R8G8B8A8 pixels into an image of the requested format
+void convertReadback(const unsigned int* src, int srcPitch, int width, int height, ReadbackFormat format, ReadbackImage& out);
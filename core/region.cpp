@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <climits>
+#include "region.h"
+
+//! Constructor
+Region::Region()
+  : mTop(0)
+  , mRowOffsets(1, 0)
+{
+}
+
+//! Create a region that covers a rectangle
+Region Region::fromRect(int x, int y, int width, int height)
+{
+  Region region;
+  if ((width <= 0) || (height <= 0))
+    return region;
+
+  region.mTop = y;
+  region.mRowOffsets.resize(height + 1);
+  region.mSpans.resize(height);
+  for (int row = 0; row < height; ++row)
+  {
+    region.mRowOffsets[row] = row;
+    region.mSpans[row].x0 = x;
+    region.mSpans[row].x1 = x + width;
+  }
+  region.mRowOffsets[height] = height;
+
+  return region;
+}
+
+//! Create a region from spans in any order, overlapping spans are merged
+Region Region::fromSpans(std::vector<RegionRowSpan>& spans)
+{
+  Region region;
+
+  // Drop empty spans and sort by row, then by start
+  spans.erase(std::remove_if(spans.begin(), spans.end(),
+    [](const RegionRowSpan& span) { return span.x1 <= span.x0; }), spans.end());
+  if (spans.empty())
+    return region;
+
+  std::sort(spans.begin(), spans.end(), [](const RegionRowSpan& a, const RegionRowSpan& b)
+  {
+    return (a.y != b.y) ? (a.y < b.y) : (a.x0 < b.x0);
+  });
+
+  region.mTop = spans.front().y;
+  int rowCount = spans.back().y - region.mTop + 1;
+  region.mRowOffsets.assign(rowCount + 1, 0);
+  region.mSpans.reserve(spans.size());
+
+  int currRow = 0;
+  for (size_t i = 0; i < spans.size(); ++i)
+  {
+    int row = spans[i].y - region.mTop;
+
+    // Rows without spans start where the next row starts
+    while (currRow < row)
+      region.mRowOffsets[++currRow] = (int)region.mSpans.size();
+
+    // Merge with the previous span of this row when they touch
+    bool sameRow = (int)region.mSpans.size() > region.mRowOffsets[row];
+    if (sameRow && (spans[i].x0 <= region.mSpans.back().x1))
+      region.mSpans.back().x1 = std::max(region.mSpans.back().x1, spans[i].x1);
+    else
+    {
+      RegionSpan span = { spans[i].x0, spans[i].x1 };
+      region.mSpans.push_back(span);
+    }
+  }
+  region.mRowOffsets[rowCount] = (int)region.mSpans.size();
+
+  return region;
+}
+
+//! Union of both regions
+Region Region::unite(const Region& other) const
+{
+  return combine(other, CombineOp_Union);
+}
+
+//! Pixels that are in both regions
+Region Region::intersect(const Region& other) const
+{
+  return combine(other, CombineOp_Intersect);
+}
+
+//! Pixels of this region that are not in the other region
+Region Region::subtract(const Region& other) const
+{
+  return combine(other, CombineOp_Subtract);
+}
+
+//! Check if a pixel is part of the region
+bool Region::contains(int x, int y) const
+{
+  int count;
+  const RegionSpan* spans = getRowSpans(y, &count);
+  for (int i = 0; i < count; ++i)
+  {
+    if (x < spans[i].x0)
+      return false;
+    if (x < spans[i].x1)
+      return true;
+  }
+  return false;
+}
+
+//! Return the spans of a row
+const RegionSpan* Region::getRowSpans(int y, int* pCount) const
+{
+  int row = y - mTop;
+  if ((row < 0) || (row >= getRowCount()))
+  {
+    *pCount = 0;
+    return nullptr;
+  }
+
+  *pCount = mRowOffsets[row + 1] - mRowOffsets[row];
+  return mSpans.data() + mRowOffsets[row];
+}
+
+//! Combine two regions row by row
+//  Both span lists of a row are sorted, so the row is swept once over the
+//  merged span boundaries, tracking whether we are inside either region.
+Region Region::combine(const Region& other, CombineOp op) const
+{
+  Region result;
+  if (isEmpty() && other.isEmpty())
+    return result;
+
+  int top, bottom;
+  if (isEmpty())
+  {
+    top = other.getTop();
+    bottom = other.getBottom();
+  }
+  else if (other.isEmpty())
+  {
+    top = getTop();
+    bottom = getBottom();
+  }
+  else
+  {
+    top = std::min(getTop(), other.getTop());
+    bottom = std::max(getBottom(), other.getBottom());
+  }
+
+  if (op == CombineOp_Intersect)
+  {
+    top = std::max(getTop(), other.getTop());
+    bottom = std::min(getBottom(), other.getBottom());
+  }
+  else if (op == CombineOp_Subtract)
+  {
+    top = getTop();
+    bottom = getBottom();
+  }
+
+  if (top >= bottom)
+    return result;
+
+  result.mTop = top;
+  result.mRowOffsets.assign(bottom - top + 1, 0);
+
+  for (int y = top; y < bottom; ++y)
+  {
+    result.mRowOffsets[y - top] = (int)result.mSpans.size();
+
+    int countA, countB;
+    const RegionSpan* spansA = getRowSpans(y, &countA);
+    const RegionSpan* spansB = other.getRowSpans(y, &countB);
+
+    // Boundaries are visited as edge indices: even = span start, odd = span end
+    int edgeA = 0, edgeB = 0;
+    const int edgeCountA = countA * 2, edgeCountB = countB * 2;
+    bool inside = false;
+    int start = 0;
+
+    while ((edgeA < edgeCountA) || (edgeB < edgeCountB))
+    {
+      int xA = (edgeA < edgeCountA) ? ((edgeA & 1) ? spansA[edgeA >> 1].x1 : spansA[edgeA >> 1].x0) : INT_MAX;
+      int xB = (edgeB < edgeCountB) ? ((edgeB & 1) ? spansB[edgeB >> 1].x1 : spansB[edgeB >> 1].x0) : INT_MAX;
+      int x = std::min(xA, xB);
+
+      // Consume all edges at this position before evaluating the operator
+      if (xA == x)
+        edgeA++;
+      if (xB == x)
+        edgeB++;
+
+      bool inA = (edgeA & 1) != 0;
+      bool inB = (edgeB & 1) != 0;
+      bool in = (op == CombineOp_Union) ? (inA || inB)
+        : (op == CombineOp_Intersect) ? (inA && inB)
+        : (inA && !inB);
+
+      if (in && !inside)
+        start = x;
+      else if (!in && inside)
+      {
+        RegionSpan span = { start, x };
+        result.mSpans.push_back(span);
+      }
+      inside = in;
+    }
+  }
+  result.mRowOffsets[bottom - top] = (int)result.mSpans.size();
+
+  result.trim();
+  return result;
+}
+
+//! Remove empty rows at the top and bottom
+void Region::trim()
+{
+  if (mSpans.empty())
+  {
+    *this = Region();
+    return;
+  }
+
+  int rowCount = getRowCount();
+  int first = 0;
+  while (mRowOffsets[first + 1] == mRowOffsets[first])
+    first++;
+
+  int last = rowCount - 1;
+  while (mRowOffsets[last + 1] == mRowOffsets[last])
+    last--;
+
+  if ((first == 0) && (last == rowCount - 1))
+    return;
+
+  std::vector<int> offsets(mRowOffsets.begin() + first, mRowOffsets.begin() + last + 2);
+  int base = offsets.front();
+  for (size_t i = 0; i < offsets.size(); ++i)
+    offsets[i] -= base;
+
+  mSpans.erase(mSpans.begin() + mRowOffsets[last + 1], mSpans.end());
+  mSpans.erase(mSpans.begin(), mSpans.begin() + base);
+  mRowOffsets.swap(offsets);
+  mTop += first;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vector>
+#include "device.h"
+#include "raster.h"
+
+//! Horizontal run of pixels [x0, x1)
+struct RegionSpan
+{
+  int x0;
+  int x1;
+};
+
+//! Span of a specific row, used to build regions from unsorted input
+struct RegionRowSpan
+{
+  int y;
+  int x0;
+  int x1;
+};
+
+//! Set of pixels stored as run-length encoded spans per row
+//  Rows are kept in one flat array of spans sorted by x, with an offset table
+//  per row, so walking a region is a linear pass over memory. Regions are
+//  immutable, the boolean operations return a new region.
+class Region
+{
+public:
+  Region();
+
+  //! Build a region
+  static Region fromRect(int x, int y, int width, int height);
+  static Region fromSpans(std::vector<RegionRowSpan>& spans);
+
+  //! Boolean operations
+  Region unite(const Region& other) const;
+  Region intersect(const Region& other) const;
+  Region subtract(const Region& other) const;
+
+  //! Access to the region info
+  bool isEmpty() const { return mSpans.empty(); }
+  bool contains(int x, int y) const;
+  int getTop() const { return mTop; }
+  int getBottom() const { return mTop + getRowCount(); }
+  int getRowCount() const { return (int)mRowOffsets.size() - 1; }
+
+  //! Spans of row 'y', the count is 0 for rows outside of the region
+  const RegionSpan* getRowSpans(int y, int* pCount) const;
+
+private:
+  //! Operators for combine()
+  enum CombineOp
+  {
+    CombineOp_Union,
+    CombineOp_Intersect,
+    CombineOp_Subtract,
+  };
+
+  Region combine(const Region& other, CombineOp op) const;
+  void trim();
+
+private:
+  //! First row of the region
+  int mTop;
+
+  //! Index of the first span of every row, with one extra entry at the end
+  std::vector<int> mRowOffsets;
+
+  //! Spans of all rows
+  std::vector<RegionSpan> mSpans;
+};
+
+//! Fill all pixels of the region, useful to fill shapes through a clip mask
+template<class Shader>
+void fillRegion(ScreenPixelData* pixelData, const Region& region, const Shader& shader)
+{
+  if (pixelData == nullptr)
+    return;
+
+  for (int y = region.getTop(); y < region.getBottom(); ++y)
+  {
+    int count;
+    const RegionSpan* spans = region.getRowSpans(y, &count);
+    for (int i = 0; i < count; ++i)
+      fillSpan(pixelData, spans[i].x0, y, spans[i].x1 - spans[i].x0, shader);
+  }
+}
@@ -0,0 +1,148 @@
+#include "resolution.h"
+
+namespace
+{
+  //! Scale levels as fractions of the output size, from full resolution down
+  //  Whole divisors are included so that nearest filtering can use the
+  //  integer fast path of the scaler.
+  struct ScaleLevel
+  {
+    int numerator;
+    int denominator;
+  };
+
+  const ScaleLevel ScaleLevels[] = {
+    { 1, 1 },
+    { 3, 4 },
+    { 2, 3 },
+    { 1, 2 },
+    { 1, 3 },
+    { 1, 4 },
+  };
+  const int ScaleLevelCount = sizeof(ScaleLevels) / sizeof(ScaleLevel);
+
+  //! Fraction of the output pixels that a level renders
+  float getLevelArea(int level)
+  {
+    const ScaleLevel& scale = ScaleLevels[level];
+    return (float)(scale.numerator * scale.numerator) / (float)(scale.denominator * scale.denominator);
+  }
+
+  //! Frames the time needs to stay out of range before the level changes
+  //  Going up needs more patience than going down, a spike is worse than
+  //  rendering a little softer for a while.
+  const int SlowFramesToDrop = 3;
+  const int FastFramesToRaise = 30;
+
+  //! Range around the budget in which the level is kept
+  const float SlowThreshold = 1.0f;
+  const float FastThreshold = 0.7f;
+
+  //! Weight of the latest frame in the average
+  const float AverageWeight = 0.2f;
+}
+
+//! Constructor
+DynamicResolution::DynamicResolution(float frameBudgetMs, ScaleFilter filter)
+  : mFrameBudgetMs(frameBudgetMs)
+  , mAverageMs(0.0f)
+  , mLevel(0)
+  , mSlowFrames(0)
+  , mFastFrames(0)
+  , mEnabled(true)
+  , mFilter(filter)
+{
+}
+
+//! Prepare the render surface for the current level
+ScreenPixelData* DynamicResolution::beginFrame(int outputWidth, int outputHeight)
+{
+  const ScaleLevel& level = ScaleLevels[mLevel];
+  int width = outputWidth * level.numerator / level.denominator;
+  int height = outputHeight * level.numerator / level.denominator;
+  mSurface.resize(width > 0 ? width : 1, height > 0 ? height : 1);
+
+  mFrameStart = std::chrono::steady_clock::now();
+  return mSurface.getPixelData();
+}
+
+//! Measure the frame, upscale and adapt the level
+void DynamicResolution::endFrame(ScreenPixelData* output)
+{
+  std::chrono::duration<float, std::milli> frameTime = std::chrono::steady_clock::now() - mFrameStart;
+
+  if (output != nullptr)
+    scalePixels(mSurface.getPixelData(), output, mFilter);
+
+  if (mEnabled)
+    adapt(frameTime.count());
+}
+
+//! Enable or disable the scaling, disabled renders at full resolution
+void DynamicResolution::setEnabled(bool enabled)
+{
+  mEnabled = enabled;
+  if (!mEnabled)
+    mLevel = 0;
+
+  mSlowFrames = 0;
+  mFastFrames = 0;
+}
+
+//! Update the average and move between levels with hysteresis
+void DynamicResolution::adapt(float frameMs)
+{
+  if (mAverageMs <= 0.0f)
+    mAverageMs = frameMs;
+  else
+    mAverageMs += (frameMs - mAverageMs) * AverageWeight;
+
+  if (mAverageMs > mFrameBudgetMs * SlowThreshold)
+  {
+    mSlowFrames++;
+    mFastFrames = 0;
+  }
+  else if (mAverageMs < mFrameBudgetMs * FastThreshold)
+  {
+    mFastFrames++;
+    mSlowFrames = 0;
+  }
+  else
+  {
+    mSlowFrames = 0;
+    mFastFrames = 0;
+  }
+
+  // Predict the cost at a level from the pixel count
+  int newLevel = mLevel;
+  float newAverageMs = mAverageMs;
+  if ((mSlowFrames >= SlowFramesToDrop) && (mLevel < ScaleLevelCount - 1))
+  {
+    newLevel = mLevel + 1;
+    newAverageMs = mAverageMs * getLevelArea(newLevel) / getLevelArea(mLevel);
+  }
+  else if ((mFastFrames >= FastFramesToRaise) && (mLevel > 0))
+  {
+    // Only raise when the higher level is predicted to fit the budget, the
+    // pixel ratio between levels is larger than the band between the
+    // thresholds, so otherwise it would drop right back
+    float predictedMs = mAverageMs * getLevelArea(mLevel - 1) / getLevelArea(mLevel);
+    if (predictedMs < mFrameBudgetMs * SlowThreshold)
+    {
+      newLevel = mLevel - 1;
+      newAverageMs = predictedMs;
+    }
+    else
+      mFastFrames = 0;
+  }
+
+  if (newLevel != mLevel)
+  {
+    // Start from the predicted cost, so the average does not immediately
+    // trigger another change
+    mAverageMs = newAverageMs;
+    mLevel = newLevel;
+    mSlowFrames = 0;
+    mFastFrames = 0;
+  }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <chrono>
+#include "device.h"
+#include "scaler.h"
+#include "surface.h"
+
+//! Renders into an internal surface whose resolution follows a frame time budget
+//  Usage per frame:
+//    ScreenPixelData* scene = dynRes.beginFrame(output->width, output->height);
+//    ... draw into scene ...
+//    dynRes.endFrame(output);
+//  endFrame() measures the time since beginFrame(), upscales the scene into
+//  the output and picks the resolution for the next frame. The scale only
+//  changes after the frame time has been out of range for several frames in
+//  a row, and a change resets the counters, so it does not oscillate.
+class DynamicResolution
+{
+public:
+  DynamicResolution(float frameBudgetMs, ScaleFilter filter = ScaleFilter_Bilinear);
+
+  //! Start a frame, returns the surface to render the scene into
+  ScreenPixelData* beginFrame(int outputWidth, int outputHeight);
+
+  //! Finish a frame and upscale it into the presented pixels
+  void endFrame(ScreenPixelData* output);
+
+  //! Access to certain info about the scaling
+  float getFrameBudget() const { return mFrameBudgetMs; }
+  float getAverageFrameTime() const { return mAverageMs; }
+  int getScaleLevel() const { return mLevel; }
+  int getRenderWidth() const { return mSurface.getWidth(); }
+  int getRenderHeight() const { return mSurface.getHeight(); }
+
+  //! Set scaling stuff
+  void setFrameBudget(float frameBudgetMs) { mFrameBudgetMs = frameBudgetMs; }
+  void setFilter(ScaleFilter filter) { mFilter = filter; }
+  void setEnabled(bool enabled);
+
+private:
+  void adapt(float frameMs);
+
+private:
+  //! Target time for rendering a frame
+  float mFrameBudgetMs;
+
+  //! Exponential moving average of the measured frame times
+  float mAverageMs;
+
+  //! Index into the table of scale levels, 0 is full resolution
+  int mLevel;
+
+  //! Number of frames in a row that were too slow or had time to spare
+  int mSlowFrames;
+  int mFastFrames;
+
+  //! When disabled the scene renders at full resolution
+  bool mEnabled;
+
+  ScaleFilter mFilter;
+  Surface mSurface;
+  std::chrono::steady_clock::time_point mFrameStart;
+};
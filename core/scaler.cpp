@@ -0,0 +1,167 @@
+#include <cstring>
+#include <vector>
+#include <emmintrin.h>
+#include "scaler.h"
+
+//! Pick the fastest scaler for the given sizes
+void scalePixels(const ScreenPixelData* src, ScreenPixelData* dst, ScaleFilter filter)
+{
+  if ((src == nullptr) || (dst == nullptr) || (src->width <= 0) || (src->height <= 0))
+    return;
+
+  if (filter == ScaleFilter_Nearest)
+  {
+    int factor = dst->width / src->width;
+    if ((factor >= 1) && (src->width * factor == dst->width) && (src->height * factor == dst->height))
+      scaleNearestInteger(src, dst, factor);
+    else
+      scaleNearest(src, dst);
+  }
+  else
+    scaleBilinear(src, dst);
+}
+
+//! Nearest neighbour with arbitrary ratios
+void scaleNearest(const ScreenPixelData* src, ScreenPixelData* dst)
+{
+  const int srcStride = src->pitch / 4;
+  const int dstStride = dst->pitch / 4;
+
+  // The column lookup is the same for every row, so compute it once
+  std::vector<int> columns(dst->width);
+  const int stepX = (int)(((long long)src->width << 16) / dst->width);
+  int u = stepX >> 1;
+  for (int x = 0; x < dst->width; ++x)
+  {
+    columns[x] = u >> 16;
+    u += stepX;
+  }
+
+  const int stepY = (int)(((long long)src->height << 16) / dst->height);
+  int v = stepY >> 1;
+  int prevRow = -1;
+  for (int y = 0; y < dst->height; ++y)
+  {
+    int row = v >> 16;
+    unsigned int* dstRow = dst->data + y * dstStride;
+
+    // Upscaled rows repeat, copy them instead of gathering again
+    if (row == prevRow)
+      memcpy(dstRow, dstRow - dstStride, dst->width * 4);
+    else
+    {
+      const unsigned int* srcRow = src->data + row * srcStride;
+      for (int x = 0; x < dst->width; ++x)
+        dstRow[x] = srcRow[columns[x]];
+    }
+
+    prevRow = row;
+    v += stepY;
+  }
+}
+
+//! Nearest neighbour where every source pixel becomes a factor x factor block
+void scaleNearestInteger(const ScreenPixelData* src, ScreenPixelData* dst, int factor)
+{
+  const int srcStride = src->pitch / 4;
+  const int dstStride = dst->pitch / 4;
+
+  for (int y = 0; y < src->height; ++y)
+  {
+    const unsigned int* srcRow = src->data + y * srcStride;
+    unsigned int* dstRow = dst->data + y * factor * dstStride;
+    int x = 0;
+
+    if (factor == 1)
+      memcpy(dstRow, srcRow, src->width * 4);
+    else if (factor == 2)
+    {
+      // abcd -> aabb ccdd
+      for (; x + 4 <= src->width; x += 4)
+      {
+        __m128i pixels = _mm_loadu_si128((const __m128i*)(srcRow + x));
+        _mm_storeu_si128((__m128i*)(dstRow + x * 2), _mm_unpacklo_epi32(pixels, pixels));
+        _mm_storeu_si128((__m128i*)(dstRow + x * 2 + 4), _mm_unpackhi_epi32(pixels, pixels));
+      }
+      for (; x < src->width; ++x)
+        dstRow[x * 2] = dstRow[x * 2 + 1] = srcRow[x];
+    }
+    else
+    {
+      // Broadcast each pixel and store whole registers of it
+      for (; x < src->width; ++x)
+      {
+        __m128i pixel = _mm_set1_epi32((int)srcRow[x]);
+        unsigned int* out = dstRow + x * factor;
+        int i = 0;
+        for (; i + 4 <= factor; i += 4)
+          _mm_storeu_si128((__m128i*)(out + i), pixel);
+        for (; i < factor; ++i)
+          out[i] = srcRow[x];
+      }
+    }
+
+    // The other rows of the block are copies of the first one
+    for (int i = 1; i < factor; ++i)
+      memcpy(dstRow + i * dstStride, dstRow, dst->width * 4);
+  }
+}
+
+//! Bilinear filtering, one pixel per SIMD register with 16 bit channels
+//  Weights are 7 bit so that the products stay within signed 16 bit.
+void scaleBilinear(const ScreenPixelData* src, ScreenPixelData* dst)
+{
+  const int srcStride = src->pitch / 4;
+  const int dstStride = dst->pitch / 4;
+  const __m128i zero = _mm_setzero_si128();
+
+  // Per column: left source pixel, right source pixel and the weight of the right one
+  std::vector<int> columns0(dst->width), columns1(dst->width), weightsX(dst->width);
+  const int stepX = (int)(((long long)src->width << 16) / dst->width);
+  int u = (stepX >> 1) - (1 << 15);
+  for (int x = 0; x < dst->width; ++x)
+  {
+    int clamped = u < 0 ? 0 : u;
+    int column = clamped >> 16;
+    columns0[x] = column;
+    columns1[x] = (column + 1) < src->width ? (column + 1) : column;
+    weightsX[x] = (clamped >> 9) & 0x7F;
+    u += stepX;
+  }
+
+  const int stepY = (int)(((long long)src->height << 16) / dst->height);
+  int v = (stepY >> 1) - (1 << 15);
+  for (int y = 0; y < dst->height; ++y)
+  {
+    int clamped = v < 0 ? 0 : v;
+    int row = clamped >> 16;
+    int nextRow = (row + 1) < src->height ? (row + 1) : row;
+    const unsigned int* srcRow0 = src->data + row * srcStride;
+    const unsigned int* srcRow1 = src->data + nextRow * srcStride;
+    unsigned int* dstRow = dst->data + y * dstStride;
+
+    // Vertical weight is the same for the whole row
+    const __m128i weightY = _mm_set1_epi16((short)((clamped >> 9) & 0x7F));
+    const __m128i invWeightY = _mm_set1_epi16((short)(128 - ((clamped >> 9) & 0x7F)));
+
+    for (int x = 0; x < dst->width; ++x)
+    {
+      // Pack left and right pixels into one register: [left | right] as 16 bit channels
+      __m128i top = _mm_unpacklo_epi8(_mm_unpacklo_epi32(_mm_cvtsi32_si128((int)srcRow0[columns0[x]]), _mm_cvtsi32_si128((int)srcRow0[columns1[x]])), zero);
+      __m128i bottom = _mm_unpacklo_epi8(_mm_unpacklo_epi32(_mm_cvtsi32_si128((int)srcRow1[columns0[x]]), _mm_cvtsi32_si128((int)srcRow1[columns1[x]])), zero);
+
+      // Vertical blend of both columns at once
+      __m128i column = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(top, invWeightY), _mm_mullo_epi16(bottom, weightY)), 7);
+
+      // Horizontal blend: weights are [128 - wx (x4) | wx (x4)]
+      __m128i weights = _mm_unpacklo_epi64(_mm_set1_epi16((short)(128 - weightsX[x])), _mm_set1_epi16((short)weightsX[x]));
+      __m128i weighted = _mm_mullo_epi16(column, weights);
+      __m128i sum = _mm_add_epi16(weighted, _mm_srli_si128(weighted, 8));
+      sum = _mm_srli_epi16(sum, 7);
+
+      dstRow[x] = (unsigned int)_mm_cvtsi128_si32(_mm_packus_epi16(sum, zero));
+    }
+
+    v += stepY;
+  }
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "device.h"
+
+//! Filters for scaling pixels
+enum ScaleFilter
+{
+  ScaleFilter_Nearest,
+  ScaleFilter_Bilinear,
+};
+
+//! Scale the whole source into the whole destination
+//  Nearest scaling by a whole number factor takes a fast path that writes the
+//  pixel repeats with SIMD stores and copies the duplicated rows.
+void scalePixels(const ScreenPixelData* src, ScreenPixelData* dst, ScaleFilter filter);
+
+//! Individual scalers, scalePixels() picks one of these
+void scaleNearest(const ScreenPixelData* src, ScreenPixelData* dst);
+void scaleNearestInteger(const ScreenPixelData* src, ScreenPixelData* dst, int factor);
+void scaleBilinear(const ScreenPixelData* src, ScreenPixelData* dst);
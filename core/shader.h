@@ -0,0 +1,278 @@
+#pragma once
+
+#include <cmath>
+#include "device.h"
+#include "pixelformat.h"
+
+//! Span shaders
+//  A span shader writes the colors for a horizontal run of pixels. The fill
+//  functions in raster.h take the shader as a template parameter, so every
+//  shape/shader/pixel format combination is compiled into its own inner loop
+//  without virtual calls.
+//
+//  Every shader implements:
+//    void shadeSpan(int x, int y, int count, unsigned int* dst) const;
+//  which writes 'count' pixels of row 'y' starting at column 'x' into 'dst'.
+
+//! 16.16 fixed point helpers
+typedef int Fixed16;
+const int Fixed16Shift = 16;
+const Fixed16 Fixed16One = 1 << Fixed16Shift;
+
+inline Fixed16 toFixed16(float value) { return (Fixed16)floorf(value * (float)Fixed16One + 0.5f); }
+
+//! Number of entries in a gradient color table
+const int GradientLutSize = 256;
+
+//! Columns between two exact evaluations of a linear gradient, a power of 2
+const int GradientAnchorSpacing = 64;
+
+//! How a gradient behaves outside of the [0, 1] range
+enum GradientSpread
+{
+  GradientSpread_Pad,
+  GradientSpread_Repeat,
+};
+
+//! A single color stop of a gradient, colors are ARGB
+struct GradientStop
+{
+  float offset;
+  unsigned int color;
+};
+
+//! Interpolates the stops into a lookup table of packed colors, no stops gives transparent black
+template<class Format>
+void buildGradientLut(const GradientStop* pStops, int stopCount, unsigned int* pLut)
+{
+  // Without stops the gradient is transparent black
+  if ((pStops == nullptr) || (stopCount <= 0))
+  {
+    for (int i = 0; i < GradientLutSize; ++i)
+      pLut[i] = Format::pack(0, 0, 0, 0);
+    return;
+  }
+
+  for (int i = 0; i < GradientLutSize; ++i)
+  {
+    float t = (float)i / (float)(GradientLutSize - 1);
+
+    // Find the stops surrounding t
+    int next = 0;
+    while ((next < stopCount) && (pStops[next].offset < t))
+      next++;
+
+    unsigned int c0, c1;
+    float f = 0.0f;
+    if (next == 0)
+      c0 = c1 = pStops[0].color;
+    else if (next == stopCount)
+      c0 = c1 = pStops[stopCount - 1].color;
+    else
+    {
+      c0 = pStops[next - 1].color;
+      c1 = pStops[next].color;
+      float range = pStops[next].offset - pStops[next - 1].offset;
+      f = (range > 0.0f) ? (t - pStops[next - 1].offset) / range : 1.0f;
+    }
+
+    unsigned int channels[4];
+    for (int c = 0; c < 4; ++c)
+    {
+      float v0 = (float)((c0 >> (c * 8)) & 0xFF);
+      float v1 = (float)((c1 >> (c * 8)) & 0xFF);
+      channels[c] = (unsigned int)(v0 + (v1 - v0) * f + 0.5f);
+    }
+
+    // channels holds b, g, r, a
+    pLut[i] = Format::pack(channels[2], channels[1], channels[0], channels[3]);
+  }
+}
+
+//! Maps a 16.16 gradient position to a lookup table index
+template<GradientSpread Spread>
+inline int gradientIndex(Fixed16 t);
+
+template<>
+inline int gradientIndex<GradientSpread_Pad>(Fixed16 t)
+{
+  int index = t >> (Fixed16Shift - 8);
+  index = index < 0 ? 0 : index;
+  return index > (GradientLutSize - 1) ? (GradientLutSize - 1) : index;
+}
+
+template<>
+inline int gradientIndex<GradientSpread_Repeat>(Fixed16 t)
+{
+  return (t >> (Fixed16Shift - 8)) & (GradientLutSize - 1);
+}
+
+//! Fills with a single color
+template<class Format = PixelFormatBackBuffer>
+class SolidShader
+{
+public:
+  explicit SolidShader(unsigned int argb)
+    : mColor(Format::fromArgb(argb))
+  {
+  }
+
+  void shadeSpan(int x, int y, int count, unsigned int* dst) const
+  {
+    const unsigned int color = mColor;
+    for (int i = 0; i < count; ++i)
+      dst[i] = color;
+  }
+
+private:
+  unsigned int mColor;
+};
+
+//! Linear gradient between two points
+//  The gradient position is an affine function of x and y, so it is stepped by
+//  a constant per pixel in fixed point. It is evaluated exactly at the span
+//  start and at every multiple of GradientAnchorSpacing columns, so the
+//  rounding error of the step cannot build up and spans that start at
+//  different columns agree from the first shared anchor on.
+template<class Format = PixelFormatBackBuffer, GradientSpread Spread = GradientSpread_Pad>
+class LinearGradientShader
+{
+public:
+  LinearGradientShader(float x0, float y0, float x1, float y1, const GradientStop* pStops, int stopCount)
+  {
+    float dx = x1 - x0;
+    float dy = y1 - y0;
+    float lengthSq = dx * dx + dy * dy;
+    if (lengthSq <= 0.0f)
+      lengthSq = 1.0f;
+
+    // t(x, y) = ((x, y) - p0) . d / |d|^2, sampled at the pixel centers
+    mGradX = dx / lengthSq;
+    mGradY = dy / lengthSq;
+    mOffset = 0.5f * (mGradX + mGradY) - (x0 * mGradX + y0 * mGradY);
+    mStep = toFixed16(mGradX);
+
+    buildGradientLut<Format>(pStops, stopCount, mLut);
+  }
+
+  void shadeSpan(int x, int y, int count, unsigned int* dst) const
+  {
+    const float rowOffset = mGradY * (float)y + mOffset;
+    const Fixed16 step = mStep;
+    const int end = x + count;
+    while (x < end)
+    {
+      int anchor = (x & ~(GradientAnchorSpacing - 1)) + GradientAnchorSpacing;
+      int runEnd = anchor < end ? anchor : end;
+
+      Fixed16 t = toFixed16(mGradX * (float)x + rowOffset);
+      for (; x < runEnd; ++x)
+      {
+        *dst++ = mLut[gradientIndex<Spread>(t)];
+        t += step;
+      }
+    }
+  }
+
+private:
+  float mGradX;
+  float mGradY;
+  float mOffset;
+  Fixed16 mStep;
+  unsigned int mLut[GradientLutSize];
+};
+
+//! Radial gradient around a center point
+//  The squared distance is stepped incrementally across the span, leaving a
+//  single square root per pixel.
+template<class Format = PixelFormatBackBuffer, GradientSpread Spread = GradientSpread_Pad>
+class RadialGradientShader
+{
+public:
+  RadialGradientShader(float cx, float cy, float radius, const GradientStop* pStops, int stopCount)
+    : mCenterX(cx)
+    , mCenterY(cy)
+    , mScale((radius > 0.0f) ? (float)Fixed16One / radius : 0.0f)
+  {
+    buildGradientLut<Format>(pStops, stopCount, mLut);
+  }
+
+  void shadeSpan(int x, int y, int count, unsigned int* dst) const
+  {
+    float dx = (float)x + 0.5f - mCenterX;
+    float dy = (float)y + 0.5f - mCenterY;
+    float distSq = dx * dx + dy * dy;
+    const float scale = mScale;
+    for (int i = 0; i < count; ++i)
+    {
+      Fixed16 t = (Fixed16)(sqrtf(distSq) * scale);
+      dst[i] = mLut[gradientIndex<Spread>(t)];
+
+      // (dx + 1)^2 = dx^2 + 2dx + 1
+      distSq += 2.0f * dx + 1.0f;
+      dx += 1.0f;
+    }
+  }
+
+private:
+  float mCenterX;
+  float mCenterY;
+  float mScale;
+  unsigned int mLut[GradientLutSize];
+};
+
+//! Two colored checker board, the cell size is a power of two
+template<class Format = PixelFormatBackBuffer>
+class CheckerShader
+{
+public:
+  CheckerShader(unsigned int argb0, unsigned int argb1, int cellShift)
+    : mCellShift(cellShift)
+  {
+    mColors[0] = Format::fromArgb(argb0);
+    mColors[1] = Format::fromArgb(argb1);
+  }
+
+  void shadeSpan(int x, int y, int count, unsigned int* dst) const
+  {
+    const int shift = mCellShift;
+    const int row = (y >> shift) & 1;
+    for (int i = 0; i < count; ++i)
+      dst[i] = mColors[(((x + i) >> shift) & 1) ^ row];
+  }
+
+private:
+  int mCellShift;
+  unsigned int mColors[2];
+};
+
+//! Repeats a texture, the texture pixels are expected in the target format
+//  The texture dimensions have to be powers of two so wrapping is a mask.
+class TextureShader
+{
+public:
+  TextureShader(const ScreenPixelData& texture, int originX, int originY)
+    : mTexture(texture)
+    , mOriginX(originX)
+    , mOriginY(originY)
+    , mMaskX(texture.width - 1)
+    , mMaskY(texture.height - 1)
+  {
+  }
+
+  void shadeSpan(int x, int y, int count, unsigned int* dst) const
+  {
+    const unsigned int* src = mTexture.data + ((y - mOriginY) & mMaskY) * (mTexture.pitch / 4);
+    const int maskX = mMaskX;
+    int u = x - mOriginX;
+    for (int i = 0; i < count; ++i)
+      dst[i] = src[(u + i) & maskX];
+  }
+
+private:
+  ScreenPixelData mTexture;
+  int mOriginX;
+  int mOriginY;
+  int mMaskX;
+  int mMaskY;
+};
@@ -0,0 +1,88 @@
+#include <xmmintrin.h>
+#include "surface.h"
+
+//! Constructor
+Surface::Surface()
+{
+  mPixelData.data = nullptr;
+  mPixelData.pitch = 0;
+  mPixelData.width = 0;
+  mPixelData.height = 0;
+}
+
+//! Constructor
+Surface::Surface(int cWidth, int cHeight)
+  : Surface()
+{
+  resize(cWidth, cHeight);
+}
+
+//! Destructor
+Surface::~Surface()
+{
+  freePixels();
+}
+
+//! Allocate the pixel memory
+void Surface::resize(int width, int height)
+{
+  if ((width == mPixelData.width) && (height == mPixelData.height) && (mPixelData.data != nullptr))
+    return;
+
+  freePixels();
+
+  if ((width <= 0) || (height <= 0))
+    return;
+
+  // Round each row up to 4 pixels (16 bytes)
+  int stride = (width + 3) & ~3;
+  mPixelData.data = (unsigned int*)_mm_malloc((size_t)stride * height * 4, 16);
+  if (mPixelData.data == nullptr)
+  {
+    printf("Surface allocation of %ix%i failed\n", width, height);
+    return;
+  }
+
+  mPixelData.pitch = stride * 4;
+  mPixelData.width = width;
+  mPixelData.height = height;
+}
+
+//! Fill the surface
+void Surface::clear(unsigned int value)
+{
+  if (mPixelData.data == nullptr)
+    return;
+
+  size_t count = (size_t)(mPixelData.pitch / 4) * mPixelData.height;
+  for (size_t i = 0; i < count; ++i)
+    mPixelData.data[i] = value;
+}
+
+//! Returns the pixel data, or null if nothing is allocated
+ScreenPixelData* Surface::getPixelData()
+{
+  if (mPixelData.data != nullptr)
+    return &mPixelData;
+  return nullptr;
+}
+
+//! Returns the pixel data, or null if nothing is allocated
+const ScreenPixelData* Surface::getPixelData() const
+{
+  if (mPixelData.data != nullptr)
+    return &mPixelData;
+  return nullptr;
+}
+
+//! Release the pixel memory
+void Surface::freePixels()
+{
+  if (mPixelData.data != nullptr)
+    _mm_free(mPixelData.data);
+
+  mPixelData.data = nullptr;
+  mPixelData.pitch = 0;
+  mPixelData.width = 0;
+  mPixelData.height = 0;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "device.h"
+
+//! Offscreen block of pixels, owned by the application
+//  Rows are padded to 16 bytes and the memory is 16 byte aligned, so SIMD
+//  code can use aligned loads at the start of every row.
+class Surface
+{
+public:
+  Surface();
+  Surface(int cWidth, int cHeight);
+  ~Surface();
+
+  //! (Re)allocate the pixels, the content is undefined afterwards
+  void resize(int width, int height);
+
+  //! Set all pixels to a single value
+  void clear(unsigned int value);
+
+  //! Access to certain info about the surface
+  int getWidth() const { return mPixelData.width; }
+  int getHeight() const { return mPixelData.height; }
+  ScreenPixelData* getPixelData();
+  const ScreenPixelData* getPixelData() const;
+
+private:
+  void freePixels();
+
+  //! Surfaces own memory, so no copies
+  Surface(const Surface&);
+  Surface& operator=(const Surface&);
+
+private:
+  ScreenPixelData mPixelData;
+};
@@ -0,0 +1,297 @@
+#include <cstring>
+#include <emmintrin.h>
+#include "tiledsurface.h"
+
+//! Morton offsets: x goes into the even bits, y into the odd bits
+const unsigned char TiledSurface::sMortonX[TiledSurface::TileSize] = { 0x00, 0x01, 0x04, 0x05, 0x10, 0x11, 0x14, 0x15 };
+const unsigned char TiledSurface::sMortonY[TiledSurface::TileSize] = { 0x00, 0x02, 0x08, 0x0A, 0x20, 0x22, 0x28, 0x2A };
+
+namespace
+{
+  //! Position of each 2x2 quad (4 consecutive pixels in Morton order) in a tile,
+  //! indexed by [quad row][quad column]
+  const int QuadIndex[4][4] = {
+    { 0, 1, 4, 5 },
+    { 2, 3, 6, 7 },
+    { 8, 9, 12, 13 },
+    { 10, 11, 14, 15 },
+  };
+}
+
+//! Constructor
+TiledSurface::TiledSurface()
+  : mTiles(nullptr)
+  , mWidth(0)
+  , mHeight(0)
+  , mTilesX(0)
+  , mTilesY(0)
+{
+}
+
+//! Constructor
+TiledSurface::TiledSurface(int cWidth, int cHeight)
+  : TiledSurface()
+{
+  resize(cWidth, cHeight);
+}
+
+//! Destructor
+TiledSurface::~TiledSurface()
+{
+  freeTiles();
+}
+
+//! Allocate whole tiles covering the size, aligned to cache lines
+void TiledSurface::resize(int width, int height)
+{
+  if ((width == mWidth) && (height == mHeight) && (mTiles != nullptr))
+    return;
+
+  freeTiles();
+
+  if ((width <= 0) || (height <= 0))
+    return;
+
+  int tilesX = (width + TileSize - 1) >> TileShift;
+  int tilesY = (height + TileSize - 1) >> TileShift;
+  mTiles = (unsigned int*)_mm_malloc((size_t)tilesX * tilesY * TilePixels * 4, 64);
+  if (mTiles == nullptr)
+  {
+    printf("TiledSurface allocation of %ix%i failed\n", width, height);
+    return;
+  }
+
+  mWidth = width;
+  mHeight = height;
+  mTilesX = tilesX;
+  mTilesY = tilesY;
+}
+
+//! Set all pixels to one color
+void TiledSurface::clear(unsigned int color)
+{
+  if (mTiles == nullptr)
+    return;
+
+  size_t count = (size_t)mTilesX * mTilesY * TilePixels;
+  for (size_t i = 0; i < count; ++i)
+    mTiles[i] = color;
+}
+
+//! Set a single pixel
+void TiledSurface::setPixel(int x, int y, unsigned int color)
+{
+  if ((unsigned int)x < (unsigned int)mWidth && (unsigned int)y < (unsigned int)mHeight)
+    mTiles[pixelOffset(x, y)] = color;
+}
+
+//! Fill a rectangle, tiles that are fully covered are filled as one block
+void TiledSurface::fillRect(int xOffset, int yOffset, int width, int height, unsigned int color)
+{
+  if (mTiles == nullptr)
+    return;
+
+  int x0 = xOffset < 0 ? 0 : xOffset;
+  int y0 = yOffset < 0 ? 0 : yOffset;
+  int x1 = (xOffset + width) > mWidth ? mWidth : (xOffset + width);
+  int y1 = (yOffset + height) > mHeight ? mHeight : (yOffset + height);
+  if ((x0 >= x1) || (y0 >= y1))
+    return;
+
+  for (int tileY = y0 >> TileShift; tileY <= ((y1 - 1) >> TileShift); ++tileY)
+  {
+    int ty0 = tileY << TileShift;
+    int cy0 = y0 > ty0 ? y0 : ty0;
+    int cy1 = y1 < (ty0 + TileSize) ? y1 : (ty0 + TileSize);
+
+    for (int tileX = x0 >> TileShift; tileX <= ((x1 - 1) >> TileShift); ++tileX)
+    {
+      int tx0 = tileX << TileShift;
+      int cx0 = x0 > tx0 ? x0 : tx0;
+      int cx1 = x1 < (tx0 + TileSize) ? x1 : (tx0 + TileSize);
+      unsigned int* tile = mTiles + ((size_t)tileY * mTilesX + tileX) * TilePixels;
+
+      if ((cx1 - cx0 == TileSize) && (cy1 - cy0 == TileSize))
+      {
+        for (int i = 0; i < TilePixels; ++i)
+          tile[i] = color;
+      }
+      else
+      {
+        for (int y = cy0; y < cy1; ++y)
+        {
+          unsigned int rowOffset = sMortonY[y & (TileSize - 1)];
+          for (int x = cx0; x < cx1; ++x)
+            tile[rowOffset | sMortonX[x & (TileSize - 1)]] = color;
+        }
+      }
+    }
+  }
+}
+
+//! Fill a circle, covers the same pixels as the linear fillCircle()
+void TiledSurface::fillCircle(int xOffset, int yOffset, int radius, unsigned int color)
+{
+  if ((mTiles == nullptr) || (radius < 0))
+    return;
+
+  int halfWidth = radius;
+  const int radiusSq = radius * radius;
+  for (int y = 0; y <= radius; ++y)
+  {
+    while ((halfWidth * halfWidth) + (y * y) > radiusSq)
+      halfWidth--;
+
+    fillSpan(xOffset - halfWidth, xOffset + halfWidth + 1, yOffset + y, color);
+    if (y != 0)
+      fillSpan(xOffset - halfWidth, xOffset + halfWidth + 1, yOffset - y, color);
+  }
+}
+
+//! Circle outline with the mid point algorithm, see drawCricleMidPoint in main.cpp
+void TiledSurface::drawCircle(int xOffset, int yOffset, int radius, unsigned int color)
+{
+  if (mTiles == nullptr)
+    return;
+
+  int x = radius, y = 0;
+  int point = 1 - radius;
+
+  while (x > y)
+  {
+    y++;
+
+    if (point <= 0)
+      point = point + 2 * y + 1;
+    else
+    {
+      x--;
+      point = point + 2 * y - 2 * x + 1;
+    }
+
+    if (x < y)
+      break;
+
+    setPixel(xOffset + x, yOffset + y, color);
+    setPixel(xOffset - x, yOffset + y, color);
+    setPixel(xOffset + x, yOffset - y, color);
+    setPixel(xOffset - x, yOffset - y, color);
+
+    if (x != y)
+    {
+      setPixel(xOffset + y, yOffset + x, color);
+      setPixel(xOffset - y, yOffset + x, color);
+      setPixel(xOffset + y, yOffset - x, color);
+      setPixel(xOffset - y, yOffset - x, color);
+    }
+  }
+}
+
+//! Bresenham line, both end points included
+void TiledSurface::drawLine(int x0, int y0, int x1, int y1, unsigned int color)
+{
+  if (mTiles == nullptr)
+    return;
+
+  int dx = x1 > x0 ? (x1 - x0) : (x0 - x1);
+  int dy = y1 > y0 ? (y0 - y1) : (y1 - y0);
+  int stepX = x0 < x1 ? 1 : -1;
+  int stepY = y0 < y1 ? 1 : -1;
+  int error = dx + dy;
+
+  for (;;)
+  {
+    setPixel(x0, y0, color);
+    if ((x0 == x1) && (y0 == y1))
+      break;
+
+    int error2 = 2 * error;
+    if (error2 >= dy)
+    {
+      error += dy;
+      x0 += stepX;
+    }
+    if (error2 <= dx)
+    {
+      error += dx;
+      y0 += stepY;
+    }
+  }
+}
+
+//! Convert to the linear layout
+//  A 16 byte load from a tile holds a 2x2 quad, so two neighbouring quads
+//  unpack into 4 pixels of two rows each.
+void TiledSurface::detile(ScreenPixelData* dst) const
+{
+  if ((mTiles == nullptr) || (dst == nullptr) || (dst->data == nullptr))
+    return;
+
+  const int dstStride = dst->pitch / 4;
+  const int width = dst->width < mWidth ? dst->width : mWidth;
+  const int height = dst->height < mHeight ? dst->height : mHeight;
+  const int fullTilesX = width >> TileShift;
+  const int fullTilesY = height >> TileShift;
+
+  for (int tileY = 0; tileY < fullTilesY; ++tileY)
+  {
+    const unsigned int* tile = mTiles + (size_t)tileY * mTilesX * TilePixels;
+    unsigned int* dstRow = dst->data + (size_t)(tileY << TileShift) * dstStride;
+
+    for (int tileX = 0; tileX < fullTilesX; ++tileX)
+    {
+      unsigned int* out = dstRow + (tileX << TileShift);
+      for (int quadY = 0; quadY < 4; ++quadY)
+      {
+        unsigned int* row0 = out + (quadY * 2) * dstStride;
+        unsigned int* row1 = row0 + dstStride;
+        for (int quadX = 0; quadX < 4; quadX += 2)
+        {
+          __m128i left = _mm_load_si128((const __m128i*)(tile + QuadIndex[quadY][quadX] * 4));
+          __m128i right = _mm_load_si128((const __m128i*)(tile + QuadIndex[quadY][quadX + 1] * 4));
+          _mm_storeu_si128((__m128i*)(row0 + quadX * 2), _mm_unpacklo_epi64(left, right));
+          _mm_storeu_si128((__m128i*)(row1 + quadX * 2), _mm_unpackhi_epi64(left, right));
+        }
+      }
+      tile += TilePixels;
+    }
+  }
+
+  // Partial tiles at the right and bottom edge
+  for (int y = 0; y < height; ++y)
+  {
+    int x = (y < (fullTilesY << TileShift)) ? (fullTilesX << TileShift) : 0;
+    unsigned int* dstRow = dst->data + (size_t)y * dstStride;
+    for (; x < width; ++x)
+      dstRow[x] = mTiles[pixelOffset(x, y)];
+  }
+}
+
+//! Fill pixels [x0, x1) of a row
+void TiledSurface::fillSpan(int x0, int x1, int y, unsigned int color)
+{
+  if ((unsigned int)y >= (unsigned int)mHeight)
+    return;
+
+  x0 = x0 < 0 ? 0 : x0;
+  x1 = x1 > mWidth ? mWidth : x1;
+
+  // Stay in the tile row, only the tile base changes when crossing a tile
+  unsigned int rowOffset = sMortonY[y & (TileSize - 1)];
+  unsigned int* tileRow = mTiles + (size_t)(y >> TileShift) * mTilesX * TilePixels;
+  for (int x = x0; x < x1; ++x)
+    tileRow[((size_t)(x >> TileShift) << (2 * TileShift)) | rowOffset | sMortonX[x & (TileSize - 1)]] = color;
+}
+
+//! Release the tile memory
+void TiledSurface::freeTiles()
+{
+  if (mTiles != nullptr)
+    _mm_free(mTiles);
+
+  mTiles = nullptr;
+  mWidth = 0;
+  mHeight = 0;
+  mTilesX = 0;
+  mTilesY = 0;
+}
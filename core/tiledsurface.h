@@ -0,0 +1,66 @@
+#pragma once
+
+#include "device.h"
+
+//! Offscreen surface stored as 8x8 pixel tiles
+//  Tiles are stored row by row, the pixels inside a tile in Morton (Z) order.
+//  A tile is 256 bytes, so primitives that walk vertically (lines, the sides
+//  of circles) stay within a few cache lines and pages instead of touching a
+//  new row of the linear layout for every pixel. detile() converts the
+//  surface to the linear layout of the back buffer right before present().
+class TiledSurface
+{
+public:
+  //! Tile dimensions, in pixels
+  static const int TileShift = 3;
+  static const int TileSize = 1 << TileShift;
+  static const int TilePixels = TileSize * TileSize;
+
+  TiledSurface();
+  TiledSurface(int cWidth, int cHeight);
+  ~TiledSurface();
+
+  //! (Re)allocate the tiles, the content is undefined afterwards
+  void resize(int width, int height);
+
+  //! Primitives, all clipped to the surface
+  void clear(unsigned int color);
+  void setPixel(int x, int y, unsigned int color);
+  void fillRect(int xOffset, int yOffset, int width, int height, unsigned int color);
+  void fillCircle(int xOffset, int yOffset, int radius, unsigned int color);
+  void drawCircle(int xOffset, int yOffset, int radius, unsigned int color);
+  void drawLine(int x0, int y0, int x1, int y1, unsigned int color);
+
+  //! Copy the surface into linear pixel data, e.g. the mapped back buffer
+  void detile(ScreenPixelData* dst) const;
+
+  //! Access to certain info about the surface
+  int getWidth() const { return mWidth; }
+  int getHeight() const { return mHeight; }
+
+private:
+  //! Offset of a pixel in the tile memory, no clipping
+  size_t pixelOffset(int x, int y) const
+  {
+    size_t tile = (size_t)(y >> TileShift) * mTilesX + (x >> TileShift);
+    return (tile << (2 * TileShift)) | sMortonX[x & (TileSize - 1)] | sMortonY[y & (TileSize - 1)];
+  }
+
+  void fillSpan(int x0, int x1, int y, unsigned int color);
+  void freeTiles();
+
+  //! Surfaces own memory, so no copies
+  TiledSurface(const TiledSurface&);
+  TiledSurface& operator=(const TiledSurface&);
+
+private:
+  //! Morton offsets of the x and y coordinate within a tile
+  static const unsigned char sMortonX[TileSize];
+  static const unsigned char sMortonY[TileSize];
+
+  unsigned int* mTiles;
+  int mWidth;
+  int mHeight;
+  int mTilesX;
+  int mTilesY;
+};
@@ -157,6 +157,21 @@ ScreenPixelData* Window::getPixelData()
   return nullptr;
 }
 
+//! Request a screenshot delivered through a future
+std::future<ReadbackImage> Window::requestScreenshot(const ReadbackRect& rect, ReadbackFormat format)
+{
+  if (mDevice != nullptr)
+    return mDevice->requestReadback(rect, format);
+  return std::future<ReadbackImage>();
+}
+
+//! Request a screenshot delivered through a callback
+void Window::requestScreenshot(const ReadbackRect& rect, ReadbackFormat format, ReadbackCallback pCallback, void* pUserData)
+{
+  if (mDevice != nullptr)
+    mDevice->requestReadback(rect, format, pCallback, pUserData);
+}
+
 //! Set the title for the window
 void Window::setTitle(const char* cpTitle)
 {
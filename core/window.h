@@ -81,6 +81,11 @@ public:
   void* getHandle() const { return mHWnd; }
   ScreenPixelData* getPixelData();
 
+  //! Read back pixels of the next presented frame without stalling (see Device::requestReadback)
+  // Note: The future is invalid when the window has no device
+  std::future<ReadbackImage> requestScreenshot(const ReadbackRect& rect, ReadbackFormat format);
+  void requestScreenshot(const ReadbackRect& rect, ReadbackFormat format, ReadbackCallback pCallback, void* pUserData = nullptr);
+
   //! Set window stuff
   void setTitle(const char* cpTitle);
   void setKeyDownCallback(WindowKeyEventCallback pCallback) { mKeyDownCallback = pCallback; }
@@ -0,0 +1,50 @@
+#include "workerpool.h"
+
+//! Constructor
+WorkerPool::WorkerPool(int cThreadCount)
+  : mStopping(false)
+{
+  int threadCount = cThreadCount;
+  if (threadCount <= 0)
+    threadCount = (int)std::thread::hardware_concurrency() - 1;
+  if (threadCount <= 0)
+    threadCount = 1;
+
+  for (int i = 0; i < threadCount; ++i)
+    mThreads.push_back(std::thread(&WorkerPool::workerMain, this));
+}
+
+//! Destructor, jobs that are still queued are finished first
+WorkerPool::~WorkerPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStopping = true;
+  }
+  mCondition.notify_all();
+
+  for (size_t i = 0; i < mThreads.size(); ++i)
+    mThreads[i].join();
+}
+
+//! Loop of every worker thread
+void WorkerPool::workerMain()
+{
+  for (;;)
+  {
+    std::function<void()> job;
+
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mCondition.wait(lock, [this]() { return mStopping || !mJobs.empty(); });
+
+      if (mJobs.empty())
+        return;
+
+      job = std::move(mJobs.front());
+      mJobs.pop();
+    }
+
+    job();
+  }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+//! Fixed set of threads that run submitted jobs in order of submission
+class WorkerPool
+{
+public:
+  //! A thread count of 0 uses one thread per hardware thread, minus the main thread
+  WorkerPool(int cThreadCount = 0);
+  ~WorkerPool();
+
+  //! Queue a job, the future becomes ready when the job finished
+  template<class Function>
+  std::future<typename std::result_of<Function()>::type> submit(Function function)
+  {
+    typedef typename std::result_of<Function()>::type Result;
+    std::shared_ptr<std::packaged_task<Result()>> task = std::make_shared<std::packaged_task<Result()>>(function);
+    std::future<Result> future = task->get_future();
+
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mJobs.push([task]() { (*task)(); });
+    }
+    mCondition.notify_one();
+
+    return future;
+  }
+
+  //! Access to certain info about the pool
+  int getThreadCount() const { return (int)mThreads.size(); }
+
+private:
+  void workerMain();
+
+  //! Pools own threads, so no copies
+  WorkerPool(const WorkerPool&);
+  WorkerPool& operator=(const WorkerPool&);
+
+private:
+  std::vector<std::thread> mThreads;
+  std::queue<std::function<void()>> mJobs;
+  std::mutex mMutex;
+  std::condition_variable mCondition;
+  bool mStopping;
+};